@@ -78,6 +78,12 @@
 ;;;   - There is no free bank for a new sentence: the sentence is
 ;;;     discarded.
 ;;;
+;;;   - The checksum of a sentence is wrong or missing: the sentence
+;;;     is discarded if the channel is set to drop such sentences.
+;;;
+;;;   - The address of a sentence matches a deny pattern of the
+;;;     address filter: the rest of the sentence is discarded.
+;;;
 ;;;
 ;;; Reading bits
 ;;;
@@ -140,6 +146,35 @@
 ;;; four read operations on a channel, a parse operation is
 ;;; needed. Parse calls take 24 cycles.
 ;;;
+;;; This is why only the fast port can run at 38,400 baud (set with
+;;; the F command). A bit at 38,400 baud is 208 cycles at 32 MHz, the
+;;; highest clock of the PIC, so parsing eight channels one by one
+;;; would take 192 of them, leaving 16 cycles for reads, storing and
+;;; sending. Parsing all channels at once (bit sliced) does not fit
+;;; either. Such a parser would keep the sampled bits as one byte per
+;;; port and bit time in a ring and pick the characters out when they
+;;; are complete. Counted per bit with the instructions it needs:
+;;;
+;;;   read2 for both ports, four times                      24
+;;;   take the bits of channels due at each time, 2x4x3     24
+;;;   start bit detection for idle channels, 2x4x6          48
+;;;   store two bit bytes in the ring (twice for wrap)       8
+;;;   note the start bit time per channel, 8x2+4            20
+;;;   find complete chars, free channels, 3+8x2+10          29
+;;;   pick out chars, 0.8 chars per bit x 39                31
+;;;   store a and b, 0.8 chars per bit x 94                 75
+;;;   chk and filter slots, 4x48 per 16 bits                12
+;;;                                                        ---
+;;;                                                        271
+;;;
+;;; That is 63 cycles over before any nop, goto or call overhead. The
+;;; parsing part (160) is not much below the 192 of the current
+;;; parse calls, because start bits and sample times still need
+;;; masking at every read. Also, one char is sent per store call,
+;;; which is 0.8 chars per bit, exactly what eight busy channels
+;;; receive, leaving nothing for the channel prefixes. Sources at
+;;; 38,400 baud should be connected to the fast channels.
+;;;
 ;;; Parse operations lead to stored bits. Typically one bit per
 ;;; operation if the channel is active, but rarely two (if the clock
 ;;; on the transmitter is a bit faster than the clock on the
@@ -151,21 +186,34 @@
 ;;; ready.
 ;;;
 ;;; The store calls are split in two (a and b) with a read operation
-;;; in the middle. The second part does two complex parts of the
-;;; storage: the work setting up a bank for a newly started sentence
-;;; and the work when a sentence overflows (is too long). Part a takes
-;;; 48 cycles and part b takes 46 cycles.
+;;; in the middle. The second part does three complex parts of the
+;;; storage: the work setting up a bank for a newly started sentence,
+;;; the work when a sentence overflows (is too long) and the checksum
+;;; check and queueing of a finished sentence. Part a takes 48 cycles
+;;; and part b takes 46 cycles.
+;;;
+;;; The checksum is built while storing: every character after the
+;;; first is xor'ed into XOR0 for the channel. XOR0 starts out as '*'
+;;; which cancels the '*' before the checksum digits. When the
+;;; sentence ends, the two checksum digits and their values are xor'ed
+;;; in as well, which gives zero for a correct checksum. Part a handles
+;;; the last digit and leaves FSR0 pointing to it, part b handles the
+;;; first digit, checks that the char before it is a '*' and resets
+;;; FSR0H.
 ;;;
 ;;; Stored bytes are sent over the serial connection. This is done in
 ;;; left over time in the second store calls (b) if no other work is
-;;; needed (which is mostly the case). Every second one of these send
-;;; calls move characters from the storage banks to the sending
-;;; queue. The rest moves characters from the sending queue to the
-;;; built-in UART queue. Since there are 12 storage calls per round of
-;;; the main loop this means that at most six characters will be
-;;; transmitted per round. For a rate of 115,200 baud, only 4.8
-;;; characters needs to be sent per round, so the capacity is
-;;; sufficient for that.
+;;; needed (which is mostly the case). Each of these calls takes a
+;;; step of sending (send_step): a character waiting in the sending
+;;; queue is moved to the built-in UART queue, or the sending state
+;;; machine moves on. Characters from the storage banks go directly
+;;; to the built-in queue when there is room, and otherwise to the
+;;; sending queue. Since there are 12 storage calls per round of the
+;;; main loop, up to 12 characters are transmitted per round. For a
+;;; rate of 230,400 baud, 9.6 characters needs to be sent per round,
+;;; so the capacity is sufficient for that. At 460,800 baud, the
+;;; capacity is the limit (about 28,800 characters per second), but
+;;; each character spends less time on the wire.
 ;;;
 ;;; All this leaves four time slots of around 48 cycles. These are
 ;;; used as follows:
@@ -186,6 +234,48 @@
 ;;; case, the sentence is dropped after 7-14 seconds and the bank is
 ;;; freed.
 ;;;
+;;; The last two slots have nothing to do most of the time. Then they
+;;; take a step of the address filter instead.
+;;;
+;;;
+;;; Address filter
+;;;
+;;; The address filter drops sentences by their address field (the
+;;; five chars after '$' or '!') while they are being received, so
+;;; they do not hold a bank until the end and do not use time on the
+;;; serial connection. There are eight pattern slots, each with five
+;;; chars ('?' matches any char), a mask of the channels it applies
+;;; to and an action (allow or deny). The first slot that matches
+;;; decides. A sentence that matches no slot is allowed.
+;;;
+;;; The store calls have no time for this, so the filter is a state
+;;; machine taking one step at a time (see filter_step, 38 cycles
+;;; including the call and return, 33 cycles to the return on every
+;;; path). It goes through the channels with patterns and for
+;;; a channel with a bank that has its address stored and is not
+;;; checked yet, it copies the address, compares it to one slot for
+;;; each two steps and acts on the first match. An allowed sentence is
+;;; marked as checked in bit 3 of its bank reference. For a denied
+;;; sentence, the channel is set to discard and the bank is freed.
+;;; Copying the address sets bit 4 of the bank reference, and setting
+;;; up the bank for a new sentence clears it. If the bit is cleared
+;;; when the filter is about to act, the bank was freed and reused in
+;;; the meantime (maybe by the same channel), so the check is
+;;; dropped.
+;;;
+;;; There are two steps per main loop (0.42 ms). Checking one
+;;; sentence against all eight slots takes up to 21 steps (select,
+;;; two copies, two per slot, deny or mark and free), about 4.4 ms.
+;;; The channels are checked in turn, so with sentences waiting on all
+;;; eight channels and patterns for all of them, a sentence may wait
+;;; for seven other checks first, up to about 35 ms in all. That is
+;;; 135 chars at 38,400 baud and 17 chars at 4,800 baud. So a sentence
+;;; on a busy fast channel can be stored and sent before it is
+;;; checked, and then the filter does not drop it. A sentence that
+;;; ends before it is checked is always sent as usual. The filter
+;;; saves link capacity on average but does not guarantee that a
+;;; denied sentence is never sent.
+;;;
 ;;; nop instructions are inserted where needed to ensure 52 cycles
 ;;; between read operations. Four extra nop instructions along with
 ;;; the final goto gives five extra cycles for a total of 3,3333 for
@@ -220,8 +310,8 @@
 ;;;
 ;;; Memory organization:
 ;;;
-;;; The 11 storage banks are put in physical banks 1-11 while banks 0
-;;; and 12 are used for general storage:
+;;; The 10 storage banks are put in physical banks 1-10 while banks 0,
+;;; 11 and 12 are used for general storage:
 ;;;
 ;;;   0x020-0x07F 96 General
 ;;;   0x0A0-0x0EF 80 Storage Bank 1
@@ -234,23 +324,55 @@
 ;;;   0x420-0x46F 80 Storage Bank 8
 ;;;   0x4A0-0x4EF 80 Storage Bank 9
 ;;;   0x520-0x56F 80 Storage Bank 10
-;;;   0x5A0-0x5EF 80 Storage Bank 11
+;;;   0x5A0-0x5EF 80 General
 ;;;   0x620-0x64F 48 General
 ;;;
+;;; Physical bank 11 held an eleventh storage bank until the checksum
+;;; and address filter state needed RAM. Banks 0 and 12 are full and
+;;; bank 11 only has 0x5EF left, so the bank can not be moved, and
+;;; the filter patterns can not be read from program memory within
+;;; the filter step. The cost is less buffering when the output can
+;;; not keep up. A queue model with 72 char sentences on 3 channels
+;;; at 38,400 and 5 at 4,800 baud, sent at 115,200 baud, drops this
+;;; share of the sentences with 10 and 11 banks:
+;;;
+;;;   input/output   10 banks   11 banks
+;;;       0.61         0.003%     0%
+;;;       0.86         0.27%      0.02%
+;;;       0.98         2.8%       1.0%
+;;;       1.10         10.4%      9.4%
+;;;
+;;; A burst of 24 back to back sentences on the 3 fast channels and 3
+;;; on the slow ones drops 16 of 87 sentences with 10 banks and 13 of
+;;; 87 with 11. Below about 80% output load the difference is noise;
+;;; at higher load it is about one sentence in 50 more.
+;;;
 ;;;
 ;;; Program memory organization:
 ;;;
 ;;; The goto instruction is limited to work in a 0x800 address
-;;; section, so the code is split in three main sections with a small
-;;; fourth one for settings:
+;;; section, so the code is split in four main sections with a small
+;;; fifth one for settings:
 ;;;
 ;;;   near:     0x0000-0x07FF  start, main loop, chk functions, parse functions
-;;;   far:      0x0000-0x07FF  store, send
+;;;   far:      0x0800-0x0FFF  store part a, address filter
 ;;;   veryfar:  0x1000-0x17FF  all interactive mode, init functions
-;;;   settings: 0x1F60-0x1FFF
+;;;   remote:   0x1800-0x1F1F  store part b, send
+;;;   settings: 0x1F20-0x1FFF
 ;;;
 ;;; Settings are stored in program memory to be persistent when the
-;;; device is powered off.
+;;; device is powered off. The user settings take SETTINGS_ROWS rows
+;;; of 32 words, which are erased and written together.
+;;;
+;;;
+;;; Timing verification:
+;;;
+;;; "make sim" builds the firmware with -DSIM and runs it in gpsim
+;;; with NMEA input on all channels (see sim/run_sim.sh). The spacing
+;;; of all port reads is checked in the simulation log, so a change
+;;; that breaks the cycle counts of any code path that the input
+;;; exercises is caught. The UART output is compared to a golden
+;;; file.
 ;;;
 ;;;
 ;;; Test long call correctness:
@@ -268,7 +390,7 @@ BUILD0          equ     0x20            ; For building chars for each channel
 CHAR0           equ     0x28            ; Finished chars for each channel
 BANK0           equ     0x30            ; Bank for each channel. 0xFF bank not found yet, DISCARD_BANK for discards
 SUPPRESS0       equ     0x38            ; Suppress masks. One for each channel
-TIMER0H         equ     0x40            ; Counters for busy channels, one for each channel
+XOR0            equ     0x40            ; Running checksum for each channel
 DISCARD_CHAR0   equ     0x48            ; Start char to discard for each channel, 0 means no discard
 
 READF0          equ     0x50            ; Fast port data at time 0
@@ -290,7 +412,7 @@ PHASE           equ     0x5E            ; Whether to read on round 1 (set) or 3
 DONE            equ     0x5F            ; Whether we are done with a byte and reading the stop bit (a bit for each channel)
 SEND_BK         equ     0x60            ; Bank being sent from. 0x80: not sending, 0x4?: setting up, 0x0?: sending
 SEND_END        equ     0x61            ; End address for sending
-CH_BUSY         equ     0x62            ; Flags for busy channels
+CHK_DROP        equ     0x62            ; Flags for channels dropping sentences with bad checksums
 Q_START         equ     0x63            ; Index of transmit bank queue start
 Q_END           equ     0x64            ; Index of transmit bank queue end
 FLAGS           equ     0x65            ; Various flags
@@ -313,8 +435,11 @@ ACTIVE          equ     0x71            ; Active channels
 STUCK_MODE1     equ     0x72            ; Low part of counter for stuck sentences, and related
 STUCK_MODE2     equ     0x73            ; High part of counter for stuck sentences, and related
 
-BK_FREEH        equ     0x74            ; Flags for free banks 8 - 15 (12 - 15 not used), must be in shared memory
+BK_FREEH        equ     0x74            ; Flags for free banks 8 - 15 (11 - 15 not used), must be in shared memory
 BK_FREEL        equ     0x75            ; Flags for free banks 0 - 7 (0 not used), must be in shared memory
+CH_BUSY         equ     0x76            ; Flags for busy channels, must be in shared memory
+FLT_STATE       equ     0x77            ; Next address filter step, must be in shared memory
+FLT_ANY         equ     0x78            ; Channels with address filter patterns, must be in shared memory
 
 CNT_CONGEST     equ     0x79            ; Counter for sentences dropped due to missing space
 ERR_CHN_CONGEST equ     0x7A            ; Bits indicating channels with congestion errors
@@ -328,20 +453,37 @@ SEND_CHAR       equ     0x7F            ; Single char buffer for trasnmission
 PTR1            equ     0x620           ; Pointer for each bank.
 PTR0            equ     PTR1 - 1        ; Just a reference, there is no bank 0
 
-REF1            equ     0x62B           ; Channel number for bank
+REF1            equ     0x62B           ; Channel number for bank, bits 3 and 4 set when checked and when check started by address filter
 REF0            equ     REF1 - 1        ; Just a reference, there is no bank 0
 
 QUEUE           equ     0x636           ; 16 bytes, circular buffer
 
 SEND_CNT        equ     0x646           ; 4 byte counter for sent sentences
 
-INTER_SPEED     equ     0x64B           ; The transmit baud rate (0-2) set in interactive mode
+INTER_SPEED     equ     0x64B           ; The transmit baud rate (0-4) set in interactive mode
 
 CNT_LONG        equ     0x64C           ; Counter for sentences dropped due to being too long
 ERR_CHN_LONG    equ     0x64D           ; Bits indicating channels with too long sentences
 CNT_STUCK       equ     0x64E           ; Counter for sentences dropped due to taking too long
 ERR_CHN_STUCK   equ     0x64F           ; Bits indicating channels with too slow sentences
 
+TIMER0H         equ     0x5A0           ; Counters for busy channels, one for each channel
+
+CNT_CHECKSUM    equ     0x5A8           ; Counter for sentences dropped due to bad checksums
+ERR_CHN_CHECKSUM equ    0x5A9           ; Bits indicating channels with bad checksums
+
+FLT_PAT         equ     0x5AA           ; Address filter patterns, FLT_SLOTS slots (0x5AA-0x5E1) of five
+                                        ; chars (0 for '?', else char | 0x80), channel mask, action (1 allow)
+FLT_CH          equ     0x5E2           ; Channel checked by address filter
+FLT_CHBIT       equ     0x5E3           ; Bit for channel checked by address filter
+FLT_BK          equ     0x5E4           ; Bank checked by address filter
+FLT_SLOTPTR     equ     0x5E5           ; Low address of pattern slot being checked
+FLT_CNT         equ     0x5E6           ; Number of pattern slots left to check
+FLT_ACC         equ     0x5E7           ; Mismatch bits for pattern slot being checked
+FLT_ADR0        equ     0x5E8           ; Copy of the five address chars being checked (0x5E8-0x5EC)
+CNT_FILTER      equ     0x5ED           ; Counter for sentences dropped by the address filter
+ERR_CHN_FILTER  equ     0x5EE           ; Bits indicating channels with filtered sentences
+
 ;;; Re-using memory for interactive mode:
 INTER_TMP       equ     TM0H            ; Temporary storage used in interactive mode
 INTER_CHANNEL   equ     TM0L            ; Channel number used in interactive mode
@@ -424,7 +566,7 @@ SLOW2_PIN       equ     RC3             ; Input pin for slow channel 2
 SLOW3_PIN       equ     RC2             ; Input pin for slow channel 3
 #endif
 
-BANK_MASKH      equ     0x0F            ; Banks 8-11 in use and ...
+BANK_MASKH      equ     0x07            ; Banks 8-10 in use and ...
 BANK_MASKL      equ     0xFE            ; ... banks 1-7 in use
 
 FRAME_REC_CNT_S equ     0x10            ; Stop bits to read before recovering from frame error on slow ch
@@ -432,6 +574,20 @@ FRAME_REC_CNT_F equ     0x80            ; Stop bits to read before recovering fr
 
 DISCARD_BANK    equ     12              ; Artifical unused bank number
 
+FLT_SLOTS       equ     8               ; Number of address filter pattern slots
+FLT_SLOT_SIZE   equ     7               ; Five address chars, channel mask and action
+
+FLT_SELECT      equ     0               ; Address filter steps, see filter_step
+FLT_COPY1       equ     1
+FLT_COPY2       equ     2
+FLT_SLOT_A      equ     3
+FLT_SLOT_B      equ     4
+FLT_DENY        equ     5               ; FLT_DENY + action (1 allow) gives FLT_MARK for allow
+FLT_MARK        equ     6
+FLT_FREE        equ     7
+
+SETTINGS_ROWS   equ     3               ; Flash rows of 32 words used for user settings
+
 NEWLINE_FLAGS   equ     FLAGS           ; Which flags byte to use for return-newline setting
 NEWLINE_BIT     equ     5               ; The bit
 
@@ -456,9 +612,40 @@ UART_PIN        equ     SLOW3_PIN       ; ... use last slow channel (channel 8 o
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
+;;; An address filter pattern char for the settings. '?' matches any
+;;; char, see filter_step.
+filter_char     macro   char
+
+if (char == '?')
+        retlw   0x00
+else
+        retlw   char | 0x80
+endif
+
+        endm
+
+;;; An address filter pattern slot for the settings. Action is 0 for
+;;; deny and 1 for allow.
+filter_slot     macro   c1, c2, c3, c4, c5, mask, action
+
+        filter_char     c1
+        filter_char     c2
+        filter_char     c3
+        filter_char     c4
+        filter_char     c5
+        retlw   mask
+        retlw   action
+
+        endm
+
+;;; /////////////////////////////////////////////////////////////////////////////
+
 ;;; Settings are read from program memory. They are all given in this
 ;;; macro that is used for inittial user settings as well as factory
-;;; settings.
+;;; settings. The SIM build (see sim/run_sim.sh) discards AIS
+;;; sentences on channel 3, runs channel 4 slow, drops bad checksums
+;;; on channel 1 and filters GSV sentences on channel 1 to cover
+;;; those code paths.
 settings        macro
 
         retlw   0x00            ; Suppression channel 1
@@ -472,7 +659,11 @@ settings        macro
 
         retlw   0x00            ; Discard channel 1
         retlw   0x00            ; Discard channel 2
+ifdef SIM
+        retlw   '!'             ; Discard channel 3, simulation only
+else
         retlw   0x00            ; Discard channel 3
+endif
         retlw   0x00            ; Discard channel 4
         retlw   0x00            ; Discard channel 5
         retlw   0x00            ; Discard channel 6
@@ -480,13 +671,36 @@ settings        macro
         retlw   0x00            ; Discard channel 8
 
         retlw   0x01            ; Channel output
+ifdef SIM
+        retlw   0x07            ; Fast channels, simulation only
+else
         retlw   0x0F            ; Fast channels
+endif
         retlw   0x01            ; Return newline
         retlw   0x00            ; Inverted input
         retlw   0x00            ; Inverted output
         retlw   0x02            ; Speed
         retlw   0xFF            ; Schmitt triggers
         retlw   0x00            ; OSCTUNE
+ifdef SIM
+        retlw   0x01            ; Checksum drop, simulation only
+else
+        retlw   0x00            ; Checksum drop
+endif
+
+ifdef SIM
+        filter_slot     '?', '?', 'G', 'S', 'V', 0x01, 0 ; Address filter 1, simulation only
+        filter_slot     'G', 'P', 'G', 'G', 'A', 0x01, 1 ; Address filter 2, simulation only
+else
+        filter_slot     '?', '?', '?', '?', '?', 0x00, 0 ; Address filter 1
+        filter_slot     '?', '?', '?', '?', '?', 0x00, 0 ; Address filter 2
+endif
+        filter_slot     '?', '?', '?', '?', '?', 0x00, 0 ; Address filter 3
+        filter_slot     '?', '?', '?', '?', '?', 0x00, 0 ; Address filter 4
+        filter_slot     '?', '?', '?', '?', '?', 0x00, 0 ; Address filter 5
+        filter_slot     '?', '?', '?', '?', '?', 0x00, 0 ; Address filter 6
+        filter_slot     '?', '?', '?', '?', '?', 0x00, 0 ; Address filter 7
+        filter_slot     '?', '?', '?', '?', '?', 0x00, 0 ; Address filter 8
 
         endm
 
@@ -558,6 +772,19 @@ errorlevel      +306
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
+;;; For calling code in the remote segment from the near segment.
+nrcall  macro   label
+
+        movlp   0x18
+errorlevel      -306
+        call    label
+errorlevel      +306
+        movlp   0x00
+
+        endm
+
+;;; /////////////////////////////////////////////////////////////////////////////
+
 ;;; 4 cycles. Read one port.
 read1   macro   adr
 
@@ -674,7 +901,8 @@ done:                           ; 16 cycles to here
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; 4 cycles. Sets busy flag when timer is not saturated at 255.
+;;; 4 cycles. Sets busy flag when timer is not saturated at 255. BSR
+;;; must be 11.
 tm_step macro   channel
 
         incfsz  TIMER0H + channel, W
@@ -796,9 +1024,7 @@ store:                          ; 16 cycles to here
 
         ;; 25 cycles to here
 
-        movfw   BANK0 + channel
-
-        addlw   LOW(PTR0)
+        sublw   DISCARD_BANK + LOW(PTR0) ; W = BANK0 + LOW(PTR0)
         movwf   FSR0L           ; FSR0H:L points to pointer for bank
 
         lslf    INDF0, W
@@ -806,7 +1032,7 @@ store:                          ; 16 cycles to here
         btfsc   STATUS, C
         goto    overflow        ; We have hit 0x70 or 0xF0 on low part of address, so overflow
 
-        ;; 32 cycles to here
+        ;; 31 cycles to here
 
         movfw   INDF0
         incf    INDF0, f        ; Increment pointer
@@ -817,6 +1043,7 @@ store:                          ; 16 cycles to here
 
         movfw   CHAR0 + channel
         movwf   INDF0
+        xorwf   XOR0 + channel, f ; Update checksum
 
         ;; 39 cycles to here
 
@@ -828,8 +1055,7 @@ store:                          ; 16 cycles to here
         return                  ; 43 cycles to here
 
 finish:                         ; 22 cycles to here
-        incf    CHAR0 + channel, W
-        btfsc   STATUS, Z
+        btfsc   CHAR0 + channel, 0 ; 0xFF for binary, 0 for '\r' or '\n'
         goto    binary
 
         movfw   BANK0 + channel
@@ -838,35 +1064,37 @@ finish:                         ; 22 cycles to here
         btfsc   STATUS, Z
         goto    finish_discard
 
-        movfw   Q_END
-        addlw   LOW(QUEUE)
-        movwf   FSR0L           ; FSRH:L points to the element after the last in the queue
+        ;; 28 cycles to here
 
-        ;; 32 cycles to here
+        sublw   DISCARD_BANK + LOW(PTR0) ; W = BANK0 + LOW(PTR0)
+        movwf   FSR0L           ; FSR0H:L points to pointer for bank
 
-        movfw   BANK0 + channel
-        movwf   INDF0           ; Put bank number in the queue
-        incf    Q_END, f
-        bcf     Q_END, 4        ; start over at 16
+        movfw   INDF0
+        movwf   FSR0L
+        lsrf    BANK0 + channel, W
+        movwf   FSR0H           ; FSR0H:L points to the byte after the last one
 
-        movlw   0xFF
-        movwf   BANK0 + channel ; Channel set to waiting
+        moviw   --FSR0          ; Last checksum digit
+        xorwf   XOR0 + channel, f
+        andlw   0x0F
+        btfsc   INDF0, 6
+        addlw   9               ; 'A' - 'F'
+        xorwf   XOR0 + channel, f
 
-        clrf    TIMER0H + channel ; reset timer
+;;; FSR0H is reset in part b
 
-        bcf     STATUS, C       ; No continuation later
+        bsf     BANK0 + channel, 6 ; Set bit 6 to indicate a finished sentence
 
-        incf    SEND_CNT_TMP, f ; Count sentence as sent
-        nop
+        bsf     STATUS, C       ; set carry flag for continuation later
 
         return                  ; 43 cycles to here
 
-binary:                         ; 26 cycles to here
+binary:                         ; 25 cycles to here
         movfw   BANK0 + channel
         sublw   DISCARD_BANK
         bcf     STATUS, C       ; No continuation later
         btfsc   STATUS, Z
-        goto    freturn_in_13   ; 43 cycles to here
+        goto    freturn_in_14   ; 43 cycles to here
 
         bsf     BANK0 + channel, 7 ; Set bit 7 to indicate invalid data
 
@@ -877,22 +1105,22 @@ binary:                         ; 26 cycles to here
 
         bsf     STATUS, C       ; set carry flag for continuation later
 
-        goto    freturn_in_7    ; 43 cycles to here
+        goto    freturn_in_8    ; 43 cycles to here
 
-finish_discard:                 ; 30 cycles to here
+finish_discard:                 ; 29 cycles to here
         movlw   0xFF
         movwf   BANK0 + channel ; Channel set to waiting
 
         bcf     STATUS, C       ; No continuation later
 
-        goto    freturn_in_10   ; 43 cycles to here
+        goto    freturn_in_11   ; 43 cycles to here
 
 discard:                        ; 26 cycles to here
         bcf     STATUS, C       ; No continuation later
 
         goto    freturn_in_16   ; 43 cycles to here
 
-overflow:                       ; 33 cycles to here
+overflow:                       ; 32 cycles to here
         bsf     BANK0 + channel, 7 ; Set bit 7 to indicate invalid data
 
         movlb   12
@@ -904,7 +1132,7 @@ overflow:                       ; 33 cycles to here
 
         bsf     STATUS, C       ; set carry flag for continuation later
 
-        goto    freturn_in_3    ; 43 cycles to here
+        goto    freturn_in_4    ; 43 cycles to here
 
 done:                           ; 3 cycles to here
         bcf     STATUS, C       ; No continuation later
@@ -944,28 +1172,74 @@ frame_err_no_bank:              ; 17 cycles to here
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; 46 = 41 + 5 cycles including nfcall and return. Finishes storage
-;;; of a character or does some work sending it. The send2 parameter
-;;; indicates what kind of sending work should be done.
-mv_char2        macro   channel, send2
+;;; 46 = 41 + 5 cycles including nrcall and return. Finishes storage
+;;; of a character or does some work sending it.
+mv_char2        macro   channel
 
         local   finish_bank_setup
+        local   finish_check
+        local   bank_setup
+        local   drop
         local   invalid
 
-        nopm    2
         btfsc   STATUS, C
         goto    finish_bank_setup ; Continuation from earlier
 
 ;;; No continuation, so help out with sending
-if (send2)
-        call    send_char       ; 31 cycles, so 35 cycles to here
-else
-        call    send_check      ; 31 cycles, so 35 cycles to here
-endif
+        nopm    2
+        call    send_step       ; 36 cycles, so 40 cycles to here
+
+        return                  ; 41 cycles to here
+
+finish_bank_setup:              ; 3 cycles to here
+        btfss   BANK0 + channel, 6
+        goto    bank_setup
+
+finish_check:                   ; 5 cycles to here
+        moviw   --FSR0          ; First checksum digit, part a did the last one
+        xorwf   XOR0 + channel, f
+        andlw   0x0F
+        btfsc   INDF0, 6
+        addlw   9               ; 'A' - 'F'
+        swapf   WREG, W
+        xorwf   XOR0 + channel, f ; Zero for a correct checksum
+
+        moviw   -1[FSR0]        ; Char before the checksum digits
+        xorlw   '*'
+        iorwf   XOR0 + channel, W ; Zero for a correct checksum after a '*'
+
+        movlw   6
+        movwf   FSR0H           ; Reset FSR0H to point to bank 12
+
+        btfss   CHK_DROP, channel
+        bsf     STATUS, Z       ; Channel passes all sentences
+
+        btfss   STATUS, Z
+        goto    drop
+
+        ;; 21 cycles to here
 
-        goto    vreturn_in_6    ; 41 cycles to here
+        movfw   Q_END
+        addlw   LOW(QUEUE)
+        movwf   FSR0L           ; FSRH:L points to the element after the last in the queue
+
+        movfw   BANK0 + channel
+        movwf   INDF0           ; Put bank number in the queue, send_check sets bit 6 anyway
+        incf    Q_END, f
+        bcf     Q_END, 4        ; start over at 16
+
+        movlw   0xFF
+        movwf   BANK0 + channel ; Channel set to waiting
+
+        incf    SEND_CNT_TMP, f ; Count sentence as sent
+
+        movlb   11
+        clrf    TIMER0H + channel ; reset timer
+        movlb   0
+
+        goto    rreturn_in_7    ; 41 cycles to here
 
-finish_bank_setup:              ; 5 cycles to here
+bank_setup:                     ; 6 cycles to here
         btfsc   BANK0 + channel, 7
         goto    invalid
 
@@ -1004,16 +1278,44 @@ finish_bank_setup:              ; 5 cycles to here
         movlw   6
         movwf   FSR0H           ; Reset FSR0H to point to bank 12
 
-        goto    vreturn_in_7    ; 41 cycles to here
+        movlw   '*'
+        movwf   XOR0 + channel  ; Start checksum, see top of file
+
+        goto    rreturn_in_4    ; 41 cycles to here
+
+drop:                           ; 22 cycles to here
+        movlb   11
+        incfsz  CNT_CHECKSUM, W
+        movwf   CNT_CHECKSUM
+
+        bsf     ERR_CHN_CHECKSUM, channel
+        movlb   0
+
+        movlw   0x01            ; Free the bank like free_bank does
+        btfsc   BANK0 + channel, 1
+        movlw   0x04
+        btfsc   BANK0 + channel, 0
+        lslf    WREG, f
+        btfsc   BANK0 + channel, 2
+        swapf   WREG, f
+        btfss   BANK0 + channel, 3
+        iorwf   BK_FREEL, f
+        btfsc   BANK0 + channel, 3
+        iorwf   BK_FREEH, f
+
+        movlw   0xFF
+        movwf   BANK0 + channel ; Channel set to waiting
 
-invalid:                        ; 8 cycles to here
+        return                  ; 41 cycles to here
+
+invalid:                        ; 9 cycles to here
         movfw   BANK0 + channel
-        call    free_bank       ; 16 cycles, so 25 cycles to here
+        call    free_bank       ; 16 cycles, so 26 cycles to here
 
         movlw   DISCARD_BANK
         movwf   BANK0 + channel ; Discard further data
 
-        goto    vreturn_in_14   ; 41 cycles to here
+        goto    rreturn_in_13   ; 41 cycles to here
 
         endm
 
@@ -1316,7 +1618,7 @@ main:
         read1fs READFS0
         nfcall  store_f0a
         read2   READS0
-        nvcall  store_f0b
+        nrcall  store_f0b
 
         read1   READF0
         call    parse_f0
@@ -1328,7 +1630,7 @@ main:
         nfcall  store_f1a
         read1   READF3
         nopm    2               ; before store_b to time those calls regularly
-        nvcall  store_f1b
+        nrcall  store_f1b
 
         read1   READF0
         call    parse_f0
@@ -1339,7 +1641,7 @@ main:
         read1fs READFS1
         nfcall  store_f2a
         read2   READS1
-        nvcall  store_f2b
+        nrcall  store_f2b
 
         read1   READF0
         call    parse_f0
@@ -1351,7 +1653,7 @@ main:
         nfcall  store_f3a
         read1   READF3
         nopm    2               ; before store_b to time those calls regularly
-        nvcall  store_f3b
+        nrcall  store_f3b
         nop                     ; extra cycle
 
         read1   READF0
@@ -1363,7 +1665,7 @@ main:
         read1fs READFS2
         nfcall  store_s0a
         read2   READS2
-        nvcall  store_s0b
+        nrcall  store_s0b
 
         read1   READF0
         call    parse_f0
@@ -1375,7 +1677,7 @@ main:
         nfcall  store_s1a
         read1   READF3
         nopm    2               ; before store_b to time those calls regularly
-        nvcall  store_s1b
+        nrcall  store_s1b
 
         read1   READF0
         call    parse_f0
@@ -1412,7 +1714,7 @@ main:
         read1fs READFS0
         nfcall  store_f0a
         read2   READS0
-        nvcall  store_f0b
+        nrcall  store_f0b
 
         read1   READF0
         call    parse_f0
@@ -1424,7 +1726,7 @@ main:
         nfcall  store_f1a
         read1   READF3
         nopm    2               ; before store_b to time those calls regularly
-        nvcall  store_f1b
+        nrcall  store_f1b
         nop                     ; extra cycle
 
         read1   READF0
@@ -1436,7 +1738,7 @@ main:
         read1fs READFS1
         nfcall  store_f2a
         read2   READS1
-        nvcall  store_f2b
+        nrcall  store_f2b
 
         read1   READF0
         call    parse_f0
@@ -1448,7 +1750,7 @@ main:
         nfcall  store_f3a
         read1   READF3
         nopm    2               ; before store_b to time those calls regularly
-        nvcall  store_f3b
+        nrcall  store_f3b
 
         read1   READF0
         call    parse_f0
@@ -1459,7 +1761,7 @@ main:
         read1fs READFS2
         nfcall  store_s2a
         read2   READS2
-        nvcall  store_s2b
+        nrcall  store_s2b
         nop                     ; extra cycle
 
         read1   READF0
@@ -1472,7 +1774,7 @@ main:
         nfcall  store_s3a
         read1   READF3
         nopm    2               ; before store_b to time those calls regularly
-        nvcall  store_s3b
+        nrcall  store_s3b
 
         read1   READF0
         call    parse_f0
@@ -1530,10 +1832,11 @@ chk_input:
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; 47 cycles incuding call and return. Adjust supression timers.
+;;; 47 cycles incuding call and return. Adjust supression timers, or
+;;; take an address filter step when there is nothing to adjust.
 hdl_time:
         btfss   PIR2, TMR4IF
-        goto    return_in_43    ; 44 cycles to here
+        goto    hdl_time_filter
 
         bcf     PIR2, TMR4IF
 
@@ -1541,6 +1844,8 @@ hdl_time:
 
         clrf    CH_BUSY         ; will be set appropriately below
 
+        movlb   11
+
         tm_step 0               ; 4 cycles each
         tm_step 1
         tm_step 2
@@ -1550,7 +1855,14 @@ hdl_time:
         tm_step 6
         tm_step 7
 
-        goto    return_in_8     ; 44 cycles to here
+        movlb   0
+
+        goto    return_in_6     ; 44 cycles to here
+
+hdl_time_filter:                ; 3 cycles to here
+        nfcall  filter_step     ; 38 cycles
+
+        goto    return_in_3     ; 44 cycles to here
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
@@ -1603,7 +1915,7 @@ chk_time_invalid:               ; 10 cycles to here
 
 ;;; 47 cycles including call and return. Every 7 seconds, check for
 ;;; channels with no activity since last check and free channel and
-;;; bank if held.
+;;; bank if held. An address filter step is taken when not checking.
 ;;;
 ;;; STUCK_MODE2:1 has these meanings
 ;;;
@@ -1615,7 +1927,7 @@ chk_stuck:
         incf    STUCK_MODE2, f
 
         btfss   STUCK_MODE2, 6
-        goto    return_in_41    ; 45 cycles to here
+        goto    chk_stuck_filter
 
         btfsc   STUCK_MODE1, 3
         goto    chk_stuck_reset
@@ -1687,6 +1999,11 @@ chk_stuck_done2:                ; 19 cycles to here
 
         goto    return_in_24    ; 45 cycles to here
 
+chk_stuck_filter:               ; 6 cycles to here
+        nfcall  filter_step     ; 38 cycles
+
+        return                  ; 45 cycles to here
+
 ;;; /////////////////////////////////////////////////////////////////////////////
 
 ;;; 24 cycles including call and return. Parse slow channels.
@@ -1926,124 +2243,480 @@ store_f3a:
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Convert a char that was read according to this:
-;;;
-;;;   - '\r' and '\n' becomes 0x00
-;;;
-;;;   - printable characters ('\t' and 0x20 to 0x7E) are unchanged
-;;;
-;;;   - non-printable characters become 0xFF
-convert_char:
+;;; 38 cycles including nfcall and return. Take one step of the
+;;; address filter, see top of file. FLT_STATE selects the step.
+filter_step:
+        movlb   11
+
+        movfw   FLT_STATE
         brw
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0x09             ; '\t', keep it is normal character
-        retlw  0x00             ; '\n'
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0x00             ; '\r'
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0xFF
-        retlw  0x20
-        retlw  0x21
-        retlw  0x22
-        retlw  0x23
-        retlw  0x24
-        retlw  0x25
-        retlw  0x26
-        retlw  0x27
-        retlw  0x28
-        retlw  0x29
-        retlw  0x2A
-        retlw  0x2B
-        retlw  0x2C
-        retlw  0x2D
-        retlw  0x2E
-        retlw  0x2F
-        retlw  0x30
-        retlw  0x31
-        retlw  0x32
-        retlw  0x33
-        retlw  0x34
-        retlw  0x35
-        retlw  0x36
-        retlw  0x37
-        retlw  0x38
-        retlw  0x39
-        retlw  0x3A
-        retlw  0x3B
-        retlw  0x3C
-        retlw  0x3D
-        retlw  0x3E
-        retlw  0x3F
-        retlw  0x40
-        retlw  0x41
-        retlw  0x42
-        retlw  0x43
-        retlw  0x44
-        retlw  0x45
-        retlw  0x46
-        retlw  0x47
-        retlw  0x48
-        retlw  0x49
-        retlw  0x4A
-        retlw  0x4B
-        retlw  0x4C
-        retlw  0x4D
-        retlw  0x4E
-        retlw  0x4F
-        retlw  0x50
-        retlw  0x51
-        retlw  0x52
-        retlw  0x53
-        retlw  0x54
-        retlw  0x55
-        retlw  0x56
-        retlw  0x57
-        retlw  0x58
-        retlw  0x59
-        retlw  0x5A
-        retlw  0x5B
-        retlw  0x5C
-        retlw  0x5D
-        retlw  0x5E
-        retlw  0x5F
-        retlw  0x60
-        retlw  0x61
-        retlw  0x62
-        retlw  0x63
-        retlw  0x64
-        retlw  0x65
-        retlw  0x66
-        retlw  0x67
-        retlw  0x68
-        retlw  0x69
-        retlw  0x6A
-        retlw  0x6B
-        retlw  0x6C
+        goto    flt_select
+        goto    flt_copy1
+        goto    flt_copy2
+        goto    flt_slot_a
+        goto    flt_slot_b
+        goto    flt_deny
+        goto    flt_mark
+        goto    flt_free
+
+;;; //////////
+
+;;; Move on to the next channel and start checking it if it has a bank
+;;; and there are patterns for it.
+flt_select:                     ; 6 cycles to here
+        incf    FLT_CH, W
+        andlw   0x07
+        movwf   FLT_CH
+
+        lslf    FLT_CHBIT, f
+        btfsc   STATUS, C
+        bsf     FLT_CHBIT, 0    ; FLT_CHBIT follows FLT_CH
+
+        movfw   FLT_CHBIT
+        andwf   FLT_ANY, W
+        btfsc   STATUS, Z
+        goto    freturn_in_18   ; No patterns for channel, 33 cycles to here
+
+        clrf    FSR0H
+        movfw   FLT_CH
+        addlw   LOW(BANK0)
+        movwf   FSR0L           ; FSR0H:L points to bank for channel
+
+        movfw   INDF0
+        movwf   FLT_BK
+        addlw   -11             ; Carry set if waiting or discarding
+
+        movlw   6
+        movwf   FSR0H           ; Reset FSR0H to point to bank 12
+
+        btfss   STATUS, C
+        incf    FLT_STATE, f    ; Go on to FLT_COPY1
+
+        movlb   0
+
+        goto    freturn_in_5    ; 33 cycles to here
+
+;;; //////////
+
+;;; Copy the first three address chars if the address is complete
+;;; and the bank has not been checked already.
+flt_copy1:                      ; 6 cycles to here
+        movfw   FLT_BK
+        addlw   LOW(REF0)
+        movwf   FSR0L           ; FSR0H:L points to reference for bank
+
+        btfsc   INDF0, 3
+        goto    flt_copy1_done  ; Already checked
+
+        moviw   (PTR0-REF0)[FSR0]
+        andlw   0x7F
+        sublw   0x25
+        btfsc   STATUS, C
+        goto    flt_copy1_wait  ; Address not complete yet
+
+        ;; 16 cycles to here
+
+        bsf     INDF0, 4        ; Check started, see flt_deny
+
+        lsrf    FLT_BK, W       ; Carry set for odd banks
+        movwf   FSR0H
+        movlw   0x42
+        rrf     WREG, f         ; 0x21, or 0xA1 for odd banks
+        movwf   FSR0L           ; FSR0H:L points to first address char
+
+        moviw   0[FSR0]
+        movwf   FLT_ADR0
+        moviw   1[FSR0]
+        movwf   FLT_ADR0 + 1
+        moviw   2[FSR0]
+        movwf   FLT_ADR0 + 2
+
+        movlw   6
+        movwf   FSR0H           ; Reset FSR0H to point to bank 12
+
+        incf    FLT_STATE, f    ; Go on to FLT_COPY2
+
+        movlb   0
+
+        return                  ; 33 cycles to here
+
+flt_copy1_done:                 ; 12 cycles to here
+        clrf    FLT_STATE       ; Go back to FLT_SELECT
+        movlb   0
+
+        goto    freturn_in_19   ; 33 cycles to here
+
+flt_copy1_wait:                 ; 17 cycles to here
+        clrf    FLT_STATE       ; Go back to FLT_SELECT, the channel is checked again later
+        movlb   0
+
+        goto    freturn_in_14   ; 33 cycles to here
+
+;;; //////////
+
+;;; Copy the last two address chars and start with the first slot.
+flt_copy2:                      ; 6 cycles to here
+        lsrf    FLT_BK, W
+        movwf   FSR0H
+        movlw   0x24
+        btfsc   FLT_BK, 0
+        movlw   0xA4
+        movwf   FSR0L           ; FSR0H:L points to fourth address char
+
+        moviw   0[FSR0]
+        movwf   FLT_ADR0 + 3
+        moviw   1[FSR0]
+        movwf   FLT_ADR0 + 4
+
+        movlw   6
+        movwf   FSR0H           ; Reset FSR0H to point to bank 12
+
+        movlw   LOW(FLT_PAT)
+        movwf   FLT_SLOTPTR
+        movlw   FLT_SLOTS
+        movwf   FLT_CNT
+
+        incf    FLT_STATE, f    ; Go on to FLT_SLOT_A
+
+        movlb   0
+
+        goto    freturn_in_9    ; 33 cycles to here
+
+;;; //////////
+
+;;; Compare the first three address chars with the slot, skip the slot
+;;; if it is not for the channel. A pattern char is either zero
+;;; (wildcard) or the char with bit 7 set. After xor with the address
+;;; char, adding 0x7F gives a carry for mismatches only.
+flt_slot_a:                     ; 6 cycles to here
+        movlw   HIGH(FLT_PAT)
+        movwf   FSR0H
+        movfw   FLT_SLOTPTR
+        movwf   FSR0L           ; FSR0H:L points to the slot
+
+        moviw   5[FSR0]
+        andwf   FLT_CHBIT, W
+        btfsc   STATUS, Z
+        goto    flt_slot_a_skip ; Slot is not for channel
+
+        clrf    FLT_ACC
+
+        moviw   0[FSR0]
+        xorwf   FLT_ADR0, W
+        addlw   0x7F
+        rlf     FLT_ACC, f
+
+        moviw   1[FSR0]
+        xorwf   FLT_ADR0 + 1, W
+        addlw   0x7F
+        rlf     FLT_ACC, f
+
+        moviw   2[FSR0]
+        xorwf   FLT_ADR0 + 2, W
+        addlw   0x7F
+        rlf     FLT_ACC, f
+
+        movlw   6
+        movwf   FSR0H           ; Reset FSR0H to point to bank 12
+
+        incf    FLT_STATE, f    ; Go on to FLT_SLOT_B
+
+        movlb   0
+        nop
+
+        return                  ; 33 cycles to here
+
+flt_slot_a_skip:                ; 15 cycles to here
+        movlw   6
+        movwf   FSR0H           ; Reset FSR0H to point to bank 12
+
+        movlw   FLT_SLOT_SIZE
+        addwf   FLT_SLOTPTR, f
+
+        movlw   FLT_MARK
+        decfsz  FLT_CNT, f
+        movlw   FLT_SLOT_A
+        movwf   FLT_STATE       ; Next slot, or mark as checked after last slot
+
+        movlb   0
+
+        goto    freturn_in_9    ; 33 cycles to here
+
+;;; //////////
+
+;;; Compare the last two address chars with the slot. On a match, go
+;;; on to deny or mark the sentence according to the action of the
+;;; slot.
+flt_slot_b:                     ; 6 cycles to here
+        movlw   HIGH(FLT_PAT)
+        movwf   FSR0H
+        movfw   FLT_SLOTPTR
+        movwf   FSR0L           ; FSR0H:L points to the slot
+
+        moviw   3[FSR0]
+        xorwf   FLT_ADR0 + 3, W
+        addlw   0x7F
+        rlf     FLT_ACC, f
+
+        moviw   4[FSR0]
+        xorwf   FLT_ADR0 + 4, W
+        addlw   0x7F
+        rlf     FLT_ACC, f
+
+        movlw   6
+        movwf   FSR0H           ; Reset FSR0H to point to bank 12
+
+        movlw   FLT_SLOT_SIZE
+        movf    FLT_ACC, f
+        btfsc   STATUS, Z
+        goto    flt_slot_b_match
+
+        addwf   FLT_SLOTPTR, f
+
+        movlw   FLT_MARK
+        decfsz  FLT_CNT, f
+        movlw   FLT_SLOT_A
+        movwf   FLT_STATE       ; Next slot, or mark as checked after last slot
+
+        movlb   0
+
+        goto    freturn_in_3    ; 33 cycles to here
+
+flt_slot_b_match:               ; 25 cycles to here
+        decf    FSR0H, f        ; Back to HIGH(FLT_PAT), FSR0L still points to the slot
+        moviw   6[FSR0]
+        andlw   0x01            ; Action
+        addlw   FLT_DENY
+        movwf   FLT_STATE       ; FLT_DENY or FLT_MARK
+        incf    FSR0H, f        ; Reset FSR0H to point to bank 12
+
+        movlb   0
+
+        return                  ; 33 cycles to here
+
+;;; //////////
+
+;;; Deny the sentence of a matching slot by discarding it. Nothing is
+;;; done if the bank has been set up for a new sentence since
+;;; flt_copy1 (bit 4 of the reference is cleared then) or if the
+;;; sentence is no longer being received.
+flt_deny:                       ; 6 cycles to here
+        movfw   FLT_BK
+        addlw   LOW(REF0)
+        movwf   FSR0L           ; FSR0H:L points to reference for bank
+
+        btfss   INDF0, 4
+        goto    flt_deny_stale  ; Not the sentence that was copied
+
+        clrf    FSR0H
+        movfw   FLT_CH
+        addlw   LOW(BANK0)
+        movwf   FSR0L           ; FSR0H:L points to bank for channel
+
+        movfw   INDF0
+        xorwf   FLT_BK, W
+        btfss   STATUS, Z
+        goto    flt_deny_gone
+
+        ;; 19 cycles to here
+
+        movlw   DISCARD_BANK
+        movwf   INDF0           ; Discard the rest of the sentence
+
+        movlw   FLT_FREE
+        movwf   FLT_STATE
+
+        movlw   6
+        movwf   FSR0H           ; Reset FSR0H to point to bank 12
+
+        movlb   0
+
+        goto    freturn_in_7    ; 33 cycles to here
+
+flt_deny_stale:                 ; 12 cycles to here
+        clrf    FLT_STATE       ; Go back to FLT_SELECT
+
+        movlb   0
+
+        goto    freturn_in_19   ; 33 cycles to here
+
+flt_deny_gone:                  ; 20 cycles to here
+        clrf    FLT_STATE       ; Go back to FLT_SELECT
+
+        movlw   6
+        movwf   FSR0H           ; Reset FSR0H to point to bank 12
+
+        movlb   0
+
+        goto    freturn_in_9    ; 33 cycles to here
+
+;;; //////////
+
+;;; Free the bank of a denied sentence and count it.
+flt_free:                       ; 6 cycles to here
+        movlw   0x01
+        btfsc   FLT_BK, 1
+        movlw   0x04
+        btfsc   FLT_BK, 0
+        lslf    WREG, f
+        btfsc   FLT_BK, 2
+        swapf   WREG, f
+
+        btfss   FLT_BK, 3
+        iorwf   BK_FREEL, f
+        btfsc   FLT_BK, 3
+        iorwf   BK_FREEH, f
+
+        incfsz  CNT_FILTER, W
+        movwf   CNT_FILTER
+        movfw   FLT_CHBIT
+        iorwf   ERR_CHN_FILTER, f
+
+        clrf    FLT_STATE       ; Go back to FLT_SELECT
+
+        movlb   0
+
+        goto    freturn_in_10   ; 33 cycles to here
+
+;;; //////////
+
+;;; Mark a sentence that matched an allow slot or no slot as checked,
+;;; unless the bank has been set up for a new sentence since
+;;; flt_copy1.
+flt_mark:                       ; 6 cycles to here
+        movfw   FLT_BK
+        addlw   LOW(REF0)
+        movwf   FSR0L           ; FSR0H:L points to reference for bank
+
+        btfsc   INDF0, 4
+        bsf     INDF0, 3        ; Checked, see send_setup2
+
+        clrf    FLT_STATE       ; Go back to FLT_SELECT
+
+        movlb   0
+
+        goto    freturn_in_20   ; 33 cycles to here
+
+;;; /////////////////////////////////////////////////////////////////////////////
+
+;;; Convert a char that was read according to this:
+;;;
+;;;   - '\r' and '\n' becomes 0x00
+;;;
+;;;   - printable characters ('\t' and 0x20 to 0x7E) are unchanged
+;;;
+;;;   - non-printable characters become 0xFF
+convert_char:
+        brw
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0x09             ; '\t', keep it is normal character
+        retlw  0x00             ; '\n'
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0x00             ; '\r'
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0xFF
+        retlw  0x20
+        retlw  0x21
+        retlw  0x22
+        retlw  0x23
+        retlw  0x24
+        retlw  0x25
+        retlw  0x26
+        retlw  0x27
+        retlw  0x28
+        retlw  0x29
+        retlw  0x2A
+        retlw  0x2B
+        retlw  0x2C
+        retlw  0x2D
+        retlw  0x2E
+        retlw  0x2F
+        retlw  0x30
+        retlw  0x31
+        retlw  0x32
+        retlw  0x33
+        retlw  0x34
+        retlw  0x35
+        retlw  0x36
+        retlw  0x37
+        retlw  0x38
+        retlw  0x39
+        retlw  0x3A
+        retlw  0x3B
+        retlw  0x3C
+        retlw  0x3D
+        retlw  0x3E
+        retlw  0x3F
+        retlw  0x40
+        retlw  0x41
+        retlw  0x42
+        retlw  0x43
+        retlw  0x44
+        retlw  0x45
+        retlw  0x46
+        retlw  0x47
+        retlw  0x48
+        retlw  0x49
+        retlw  0x4A
+        retlw  0x4B
+        retlw  0x4C
+        retlw  0x4D
+        retlw  0x4E
+        retlw  0x4F
+        retlw  0x50
+        retlw  0x51
+        retlw  0x52
+        retlw  0x53
+        retlw  0x54
+        retlw  0x55
+        retlw  0x56
+        retlw  0x57
+        retlw  0x58
+        retlw  0x59
+        retlw  0x5A
+        retlw  0x5B
+        retlw  0x5C
+        retlw  0x5D
+        retlw  0x5E
+        retlw  0x5F
+        retlw  0x60
+        retlw  0x61
+        retlw  0x62
+        retlw  0x63
+        retlw  0x64
+        retlw  0x65
+        retlw  0x66
+        retlw  0x67
+        retlw  0x68
+        retlw  0x69
+        retlw  0x6A
+        retlw  0x6B
+        retlw  0x6C
         retlw  0x6D
         retlw  0x6E
         retlw  0x6F
@@ -2266,1627 +2939,1885 @@ freturn_in_3:
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
-;;; Veryfar section starts here.
-;;; /////////////////////////////////////////////////////////////////////////////
+;;; Veryfar section starts here.
+;;; /////////////////////////////////////////////////////////////////////////////
+
+veryfar code    0x1000
+
+if (FAST_BIT0 != 0 || FAST_BIT1 != 1 || FAST_BIT2 != 2 || FAST_BIT3 != 3)
+        ERROR   "FAST_BITs assumed to be 0, 1, 2, and 3"
+endif
+
+;;; /////////////////////////////////////////////////////////////////////////////
+
+;;; Load user settings from program memory.
+load_user_settings:
+        movlw   LOW(user_settings)
+        movwf   FSR1L
+        movlw   HIGH(user_settings)
+        movwf   FSR1H
+
+        goto    load_settings
+
+;;; /////////////////////////////////////////////////////////////////////////////
+
+;;; Load factory settings from program memory.
+load_factory_settings:
+        movlw   LOW(factory_settings)
+        movwf   FSR1L
+        movlw   HIGH(factory_settings)
+        movwf   FSR1H
+
+        goto    load_settings
+
+;;; /////////////////////////////////////////////////////////////////////////////
+
+;;; Load settings from FSR1
+load_settings:
+        moviw   FSR1++
+        movwf   SUPPRESS0 + 0
+
+        moviw   FSR1++
+        movwf   SUPPRESS0 + 1
+
+        moviw   FSR1++
+        movwf   SUPPRESS0 + 2
+
+        moviw   FSR1++
+        movwf   SUPPRESS0 + 3
+
+        moviw   FSR1++
+        movwf   SUPPRESS0 + 4
+
+        moviw   FSR1++
+        movwf   SUPPRESS0 + 5
+
+        moviw   FSR1++
+        movwf   SUPPRESS0 + 6
+
+        moviw   FSR1++
+        movwf   SUPPRESS0 + 7
+
+        moviw   FSR1++
+        movwf   DISCARD_CHAR0 + 0
+
+        moviw   FSR1++
+        movwf   DISCARD_CHAR0 + 1
+
+        moviw   FSR1++
+        movwf   DISCARD_CHAR0 + 2
+
+        moviw   FSR1++
+        movwf   DISCARD_CHAR0 + 3
+
+        moviw   FSR1++
+        movwf   DISCARD_CHAR0 + 4
+
+        moviw   FSR1++
+        movwf   DISCARD_CHAR0 + 5
+
+        moviw   FSR1++
+        movwf   DISCARD_CHAR0 + 6
+
+        moviw   FSR1++
+        movwf   DISCARD_CHAR0 + 7
+
+        moviw   FSR1++
+        bsf     CHN_OUT_FLAGS, CHN_OUT_BIT
+        btfss   WREG, 0
+        bcf     CHN_OUT_FLAGS, CHN_OUT_BIT
+
+        movfw   FAST_FLAGS
+        andlw   0xF0
+        movwf   FAST_FLAGS
+        moviw   FSR1++
+        iorwf   FAST_FLAGS, f
+
+        moviw   FSR1++
+        bsf     NEWLINE_FLAGS, NEWLINE_BIT
+        btfss   WREG, 0
+        bcf     NEWLINE_FLAGS, NEWLINE_BIT
+
+        moviw   FSR1++
+        call    inter_set_invert
+
+        moviw   FSR1++
+        call    inter_set_invert_out
+
+        moviw   FSR1++
+        movlb   12
+        movwf   INTER_SPEED
+        movlb   0
+
+        moviw   FSR1++
+        call    inter_set_schmitt
+
+        moviw   FSR1++
+        call    inter_set_osctune
+
+        moviw   FSR1++
+        movwf   CHK_DROP
+
+        movlw   HIGH(FLT_PAT)
+        movwf   FSR0H
+        movlw   LOW(FLT_PAT)
+        movwf   FSR0L
+
+        movlw   FLT_SLOTS * FLT_SLOT_SIZE
+        movwf   INTER_TMP
+
+load_settings_filter:
+        moviw   FSR1++
+        movwi   FSR0++
+
+        decfsz  INTER_TMP, f
+        goto    load_settings_filter
+
+        movlw   6
+        movwf   FSR0H           ; Reset FSR0H to point to bank 12
+
+        call    filter_update
+
+        return
+
+;;; /////////////////////////////////////////////////////////////////////////////
 
-veryfar code    0x1000
+;;; Set FLT_ANY to the channels that have address filter patterns.
+filter_update:
+        clrf    FLT_ANY
+
+        movlb   11
+
+        movfw   FLT_PAT + 0 * FLT_SLOT_SIZE + 5
+        iorwf   FLT_ANY, f
+        movfw   FLT_PAT + 1 * FLT_SLOT_SIZE + 5
+        iorwf   FLT_ANY, f
+        movfw   FLT_PAT + 2 * FLT_SLOT_SIZE + 5
+        iorwf   FLT_ANY, f
+        movfw   FLT_PAT + 3 * FLT_SLOT_SIZE + 5
+        iorwf   FLT_ANY, f
+        movfw   FLT_PAT + 4 * FLT_SLOT_SIZE + 5
+        iorwf   FLT_ANY, f
+        movfw   FLT_PAT + 5 * FLT_SLOT_SIZE + 5
+        iorwf   FLT_ANY, f
+        movfw   FLT_PAT + 6 * FLT_SLOT_SIZE + 5
+        iorwf   FLT_ANY, f
+        movfw   FLT_PAT + 7 * FLT_SLOT_SIZE + 5
+        iorwf   FLT_ANY, f
 
-if (FAST_BIT0 != 0 || FAST_BIT1 != 1 || FAST_BIT2 != 2 || FAST_BIT3 != 3)
-        ERROR   "FAST_BITs assumed to be 0, 1, 2, and 3"
-endif
+        movlb   0
+
+        return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; 46 cycles including nfcall and return. Finishes storage or sends
-;;; data.
-store_s0b:
-        mv_char2 SLOW0_NUM, 1
+;;; Save current settings as user settings.
+save_user_settings:
+        call    write_start
 
-;;; //////////
+        movfw   SUPPRESS0 + 0
+        call    save_byte
 
-store_s1b:
-        mv_char2 SLOW1_NUM, 0
+        movfw   SUPPRESS0 + 1
+        call    save_byte
 
-;;; //////////
+        movfw   SUPPRESS0 + 2
+        call    save_byte
 
-store_s2b:
-        mv_char2 SLOW2_NUM, 1
+        movfw   SUPPRESS0 + 3
+        call    save_byte
 
-;;; //////////
+        movfw   SUPPRESS0 + 4
+        call    save_byte
 
-store_s3b:
-        mv_char2 SLOW3_NUM, 0
+        movfw   SUPPRESS0 + 5
+        call    save_byte
 
-;;; //////////
+        movfw   SUPPRESS0 + 6
+        call    save_byte
 
-store_f0b:
-        mv_char2 FAST0_NUM, 1
+        movfw   SUPPRESS0 + 7
+        call    save_byte
 
-;;; //////////
+        movfw   DISCARD_CHAR0 + 0
+        call    save_byte
 
-store_f1b:
-        mv_char2 FAST1_NUM, 0
+        movfw   DISCARD_CHAR0 + 1
+        call    save_byte
 
-;;; //////////
+        movfw   DISCARD_CHAR0 + 2
+        call    save_byte
 
-store_f2b:
-        mv_char2 FAST2_NUM, 1
+        movfw   DISCARD_CHAR0 + 3
+        call    save_byte
 
-;;; //////////
+        movfw   DISCARD_CHAR0 + 4
+        call    save_byte
 
-store_f3b:
-        mv_char2 FAST3_NUM, 0
+        movfw   DISCARD_CHAR0 + 5
+        call    save_byte
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        movfw   DISCARD_CHAR0 + 6
+        call    save_byte
 
-;;; 31 cycles including call and return. If needed, move a char from
-;;; our own transmit queue to the built-in one.
-send_char:
-        nopm    8
+        movfw   DISCARD_CHAR0 + 7
+        call    save_byte
 
-        btfss   SD_CH_FLAGS, SD_CH_BIT
-        goto    vreturn_in_19   ; 28 cycles to here, no char to send
+        movlw   0x01
+        btfss   CHN_OUT_FLAGS, CHN_OUT_BIT
+        movlw   0x00
+        call    save_byte
 
-        btfss   PIR1, TXIF
-        goto    vreturn_in_17   ; 28 cycles to here, no room
+        movfw   FAST_FLAGS
+        andlw   0x0F
+        call    save_byte
 
-        btfsc   T2CON, TMR2ON
-        btfsc   PIR1, TMR2IF
-        goto    send_char_ok    ; timer not running or has expired
+        movlw   0x01
+        btfss   NEWLINE_FLAGS, NEWLINE_BIT
+        movlw   0x00
+        call    save_byte
 
-        goto    vreturn_in_13   ; 28 cycles to here, timer running and not expired
+        call    inter_get_invert
+        call    save_byte
 
-send_char_ok:                   ; 16 cycles to here
-        bcf     PIR1, TMR2IF
-        bcf     T2CON, TMR2ON
+        call    inter_get_invert_out
+        call    save_byte
 
-        movfw   SEND_CHAR
-        sublw   '\n'
-        btfsc   STATUS, Z
-        bsf     T2CON, TMR2ON   ; start timer when newline
+        movlb   12
+        movfw   INTER_SPEED
+        movlb   0
+        call    save_byte
 
-        movfw   SEND_CHAR
-        bcf     SD_CH_FLAGS, SD_CH_BIT
+        call    inter_get_schmitt
+        call    save_byte
+
+        call    inter_get_osctune
+        call    save_byte
+
+        movfw   CHK_DROP
+        call    save_byte
+
+        movlw   HIGH(FLT_PAT)
+        movwf   FSR0H
+        movlw   LOW(FLT_PAT)
+        movwf   FSR0L
+
+        movlw   FLT_SLOTS * FLT_SLOT_SIZE - 1
+        movwf   INTER_TMP
+
+save_user_settings_filter:
+        moviw   FSR0++
+        call    save_byte
+
+        decfsz  INTER_TMP, f
+        goto    save_user_settings_filter
+
+        moviw   FSR0++
+        call    save_last_byte
+
+        movlw   6
+        movwf   FSR0H           ; Reset FSR0H to point to bank 12
+
+        return
 
+;;; /////////////////////////////////////////////////////////////////////////////
+
+;;; Erase user settings memory and get read to write.
+write_start:
+;;; We erase the user settings by erasing SETTINGS_ROWS rows of 32 words
         movlb   3
-        movwf   TXREG
+
+        movlw   LOW(user_settings)
+        movwf   PMADRL
+        movlw   HIGH(user_settings)
+        movwf   PMADRH
+
+        bcf     PMCON1, CFGS    ; Normal program memory
+        bsf     PMCON1, WREN    ; Write enable
+
+write_start_erase:
+        bsf     PMCON1, FREE    ; Free memory
+
+        movlw   0x55            ; Unlock sequence start
+        movwf   PMCON2
+        movlw   0xAA
+        movwf   PMCON2
+        bsf     PMCON1, WR
+        nop
+        nop                     ; Unlock sequence end
+
+        movlw   32
+        addwf   PMADRL, f       ; Next row
+
+        movlw   LOW(user_settings + 32 * SETTINGS_ROWS)
+        xorwf   PMADRL, W
+        btfss   STATUS, Z
+        goto    write_start_erase
+
+        movlw   LOW(user_settings)
+        movwf   PMADRL
+
+;;; Here, we are getting ready to write:
+        movlw   0x34            ; The program instruction written is
+                                ; of type retlw
+        movwf   PMDATH          ; Low byte will be supplied later
+
+        bsf     PMCON1, LWLO    ; Only output to latches
+
         movlb   0
 
-        return                  ; 28 cycles to here
+        return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; 31 cycles including call and return. Check if we need to do
-;;; something regarding sending.
-send_check:
-        btfss   SEND_BK, 7
-        goto    send_check_done ; We are already sending
+;;; Save a byte to program memory latches. The latches are written to
+;;; program memory when the last word of a row is saved.
+save_byte:
+        movlb   3
 
-        movfw   Q_END
-        subwf   Q_START, W
+        movwf   PMDATL          ; High byte already set
 
+        movfw   PMADRL
+        andlw   0x1F
+        xorlw   0x1F
         btfsc   STATUS, Z
-        goto    vreturn_in_23   ; Nothing is awaiting being sent, 28 cycles to here
+        bcf     PMCON1, LWLO    ; Last word in row, store to everything memory
 
-        movfw   Q_START
-        addlw   LOW(QUEUE)
-        movwf   FSR0L           ; FSRH:L points to the first element in the queue
+        movlw   0x55            ; Unlock sequence start
+        movwf   PMCON2
+        movlw   0xAA
+        movwf   PMCON2
+        bsf     PMCON1, WR
+        nop
+        nop                     ; Unlock sequence end
+
+        bsf     PMCON1, LWLO    ; Back to only output to latches
+
+        incf    PMADRL, f
+
+        movlb   0
+
+        return
+
+;;; /////////////////////////////////////////////////////////////////////////////
+
+;;; Save a byte along with previous latches to program memory.
+save_last_byte:
+        movlb   3
+        bcf     PMCON1, LWLO    ; Store to everything memory
+        movlb   0
+
+        call    save_byte
+
+        movlb   3
+        bcf     PMCON1, WREN    ; Disable write
+        movlb   0
+
+        return
+
+;;; /////////////////////////////////////////////////////////////////////////////
+
+;;; Set W according to which channels are inverted.
+inter_get_invert:
+        clrw
 
-        movfw   INDF0           ; W = bank to be sent
-        movwf   SEND_BK
+        btfsc   INVERT_S, SLOW0_PIN
+        bsf     WREG, SLOW0_NUM
 
-        btfsc   CHN_OUT_FLAGS, CHN_OUT_BIT
-        bsf     SEND_BK, 4
-        bsf     SEND_BK, 6
+        btfsc   INVERT_S, SLOW1_PIN
+        bsf     WREG, SLOW1_NUM
 
-        incf    Q_START, f
-        bcf     Q_START, 4      ; start over at 16
+        btfsc   INVERT_S, SLOW2_PIN
+        bsf     WREG, SLOW2_NUM
 
-        goto    vreturn_in_12   ; 28 cycles to here
+        btfsc   INVERT_S, SLOW3_PIN
+        bsf     WREG, SLOW3_NUM
 
-send_check_done:                ; 3 cycles to here
-        call    send            ; 24 cycles, so 27 cycles to here
+        btfsc   INVERT_F, FAST0_PIN
+        bsf     WREG, FAST0_NUM
 
-        return                  ; 28 cycles to here
+        btfsc   INVERT_F, FAST1_PIN
+        bsf     WREG, FAST1_NUM
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        btfsc   INVERT_F, FAST2_PIN
+        bsf     WREG, FAST2_NUM
 
-;;; 16 cycles including call and return. Free the bank given by W.
-free_bank:
-        movwf   FSR0L           ; FSR0L is not used for anything else
-        movlw   0x01
-        btfsc   FSR0L, 1
-        movlw   0x04
-        btfsc   FSR0L, 0
-        lslf    WREG, f
-        btfsc   FSR0L, 2
-        swapf   WREG, f
-        btfss   FSR0L, 3
-        iorwf   BK_FREEL, f
-        btfsc   FSR0L, 3
-        iorwf   BK_FREEH, f
+        btfsc   INVERT_F, FAST3_PIN
+        bsf     WREG, FAST3_NUM
 
-        return                  ; 13 cycles to here
+        return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; SEND_BK   10000000: not sending
-;;; SEND_BK   0100xxxx: getting ready to send from bank xxxx
-;;; SEND_BK   0101xxxx: getting ready to send from bank xxxx
-;;; SEND_BK   0010xxxx: finish of sending from bank xxxx
-;;; SEND_BK   0011xxxx: more finish of sending from bank xxxx
-;;; SEND_BK   0000xxxx: sending from bank xxxx
-
-;;; 24 cycles including call and return. Sends data from banks.
-send:
-        btfsc   SEND_BK, 5
-        goto    send_finish
-        btfsc   SEND_BK, 6
-        goto    send_setup
-        btfsc   SEND_BK, 7
-        goto    vreturn_in_16   ; 21 cycles to here
+;;; Set which channels are inverted from W.
+inter_set_invert:
+        clrf    INVERT_S
 
-do_send:                        ; 6 cycles to here
-        btfsc   SD_CH_FLAGS, SD_CH_BIT
-        goto    vreturn_in_14   ; No room for next char, 21 cycles to here
+        btfsc   WREG, SLOW0_NUM
+        bsf     INVERT_S, SLOW0_PIN
 
-        movfw   SEND_END
-        subwf   FSR1L, W
+        btfsc   WREG, SLOW1_NUM
+        bsf     INVERT_S, SLOW1_PIN
 
-        btfsc   STATUS, Z
-        goto    do_send_last
+        btfsc   WREG, SLOW2_NUM
+        bsf     INVERT_S, SLOW2_PIN
 
-;;; Not last position
-        movfw   INDF1
+        btfsc   WREG, SLOW3_NUM
+        bsf     INVERT_S, SLOW3_PIN
 
-        movwf   SEND_CHAR
-        bsf     SD_CH_FLAGS, SD_CH_BIT
+        clrf    INVERT_F
 
-        incf    FSR1L, f        ; Move pointer
+        btfsc   WREG, FAST0_NUM
+        bsf     INVERT_F, FAST0_PIN
 
-        goto    vreturn_in_5    ; 21 cycles to here
+        btfsc   WREG, FAST1_NUM
+        bsf     INVERT_F, FAST1_PIN
 
-do_send_last:                   ; 13 cycles to here
-        bsf     SEND_BK, 5      ; Stop sending
+        btfsc   WREG, FAST2_NUM
+        bsf     INVERT_F, FAST2_PIN
 
-        movlw   '\r'
-        btfss   NEWLINE_FLAGS, NEWLINE_BIT
-        movlw   '\n'
+        btfsc   WREG, FAST3_NUM
+        bsf     INVERT_F, FAST3_PIN
 
-        movwf   SEND_CHAR
-        bsf     SD_CH_FLAGS, SD_CH_BIT
+        return
 
-        nop
-        return                  ; 21 cycles to here
+;;; /////////////////////////////////////////////////////////////////////////////
 
-send_setup:                     ; 5 cycles to here
-        btfsc   SEND_BK, 4
-        goto    send_setup2
-        movlw   LOW(PTR0)
-        movwf   FSR0L
+;;; Set W according to whether output is inverted.
+inter_get_invert_out:
+        movlb   3
 
-        bcf     SEND_BK, 6
-        movfw   SEND_BK
-        movwf   FSR1H
-        addwf   FSR0L, f        ; FSR0H:L points to pointer for relevant bank
+        movlw   0x00
+        btfsc   BAUD1CON, SCKP
+        movlw   0x01
 
-        movfw   INDF0
-        movwf   SEND_END        ; SEND_END is the pointer to the byte after the last in the bank
+        movlb   0
 
-        movlw   0x40
-        movwf   FSR1L
-        lsrf    FSR1H, f
-        rrf     FSR1L, f        ; FSR1H:L points to first byte of data to be sent
+        return
 
-        nop
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        return                  ; 21 cycles to here
+;;; Set output is inversion according to W.
+inter_set_invert_out:
+        movlb   3
 
-send_setup2:                    ; 8 cycles to here
-        btfsc   SD_CH_FLAGS, SD_CH_BIT
-        goto    vreturn_in_12   ; No room for next char, 21 cycles to here
+        bcf     BAUD1CON, SCKP
+        btfsc   WREG, 0
+        bsf     BAUD1CON, SCKP
 
-        bcf     SEND_BK, 4
+        movlb   0
 
-        movfw   SEND_BK
-        addlw   LOW(REF0) - 0x40 ; Account for bit 6 being set in SEND_BK
-        movwf   FSR0L           ; FSR0H:L points to reference
+        return
 
-        movfw   INDF0
-        addlw   '1'
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        movwf   SEND_CHAR
-        bsf     SD_CH_FLAGS, SD_CH_BIT
+;;; Set W according to OSCTUNE.
+inter_get_osctune:
+        movlb   1
+        movfw   OSCTUNE
+        movlb   0
 
-        nopm    2
+        return
 
-        return                  ; 21 cycles to here
+;;; /////////////////////////////////////////////////////////////////////////////
 
-send_finish:                    ; 3 cycles to here
-        btfss   NEWLINE_FLAGS, NEWLINE_BIT
-        goto    send_finish1
-;;; Return-newline mode
+;;; Set OSCTUNE according to W.
+inter_set_osctune
+        movlb   1
+        movwf   OSCTUNE
+        movlb   0
 
-        btfsc   SEND_BK, 4
-        goto    send_finish2
+        return
 
-        movlw   0x01
-        btfsc   SEND_BK, 1
-        movlw   0x04
-        btfsc   SEND_BK, 0
-        lslf    WREG, f
-        btfsc   SEND_BK, 2
-        swapf   WREG, f
-        btfss   SEND_BK, 3
-        iorwf   BK_FREEL, f
-        btfsc   SEND_BK, 3
-        iorwf   BK_FREEH, f
+;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; The bank is now marked as free
-        bsf     SEND_BK, 4      ; do send_finish2 next time
+;;; Set W according to which channels are using Schmitt triggers.
+inter_get_schmitt:
+        clrw
 
-        nop
-        return                  ; 21 cycles to here
+        movlb   7
 
-;;; Newline only mode
-send_finish1:                   ; 6 cycles to here
-        movlw   0x01
-        btfsc   SEND_BK, 1
-        movlw   0x04
-        btfsc   SEND_BK, 0
-        lslf    WREG, f
-        btfsc   SEND_BK, 2
-        swapf   WREG, f
-        btfss   SEND_BK, 3
-        iorwf   BK_FREEL, f
-        btfsc   SEND_BK, 3
-        iorwf   BK_FREEH, f
+;;; In the following cade, SLOW_PORT and FAST_PORT refers to the
+;;; appropriate INLVLA/C registers since we are in bank 7.
 
-;;; The bank is now marked as free
-        movlw   0x80
-        movwf   SEND_BK         ; We are done sending
+        btfsc   SLOW_PORT, SLOW0_PIN
+        bsf     WREG, SLOW0_NUM
 
-        nop
-        return                  ; 21 cycles to here
+        btfsc   SLOW_PORT, SLOW1_PIN
+        bsf     WREG, SLOW1_NUM
 
-send_finish2:                   ; 8 cycles to here
-        btfsc   SD_CH_FLAGS, SD_CH_BIT
-        goto    vreturn_in_12   ; No room for next char, 21 cycles to here
+        btfsc   SLOW_PORT, SLOW2_PIN
+        bsf     WREG, SLOW2_NUM
 
-        movlw   '\n'
+        btfsc   SLOW_PORT, SLOW3_PIN
+        bsf     WREG, SLOW3_NUM
 
-        movwf   SEND_CHAR
-        bsf     SD_CH_FLAGS, SD_CH_BIT
+        btfsc   FAST_PORT, FAST0_PIN
+        bsf     WREG, FAST0_NUM
 
-        movlw   0x80
-        movwf   SEND_BK         ; We are done sending
+        btfsc   FAST_PORT, FAST1_PIN
+        bsf     WREG, FAST1_NUM
 
-        goto    vreturn_in_6    ; 21 cycles to here
+        btfsc   FAST_PORT, FAST2_PIN
+        bsf     WREG, FAST2_NUM
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        btfsc   FAST_PORT, FAST3_PIN
+        bsf     WREG, FAST3_NUM
 
-;;; Load user settings from program memory.
-load_user_settings:
-        movlw   LOW(user_settings)
-        movwf   FSR1L
-        movlw   HIGH(user_settings)
-        movwf   FSR1H
+        movlb   0
 
-        goto    load_settings
+        return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Load factory settings from program memory.
-load_factory_settings:
-        movlw   LOW(factory_settings)
-        movwf   FSR1L
-        movlw   HIGH(factory_settings)
-        movwf   FSR1H
-
-        goto    load_settings
+;;; Set which channels are using Schmitt triggers from W.
+inter_set_schmitt:
+        movlb   7
 
-;;; /////////////////////////////////////////////////////////////////////////////
+;;; In the following cade, SLOW_PORT and FAST_PORT refers to the
+;;; appropriate INLVLA/C registers since we are in bank 7.
 
-;;; Load settings from FSR1
-load_settings:
-        moviw   FSR1++
-        movwf   SUPPRESS0 + 0
+        bcf     SLOW_PORT, SLOW0_PIN
+        btfsc   WREG, SLOW0_NUM
+        bsf     SLOW_PORT, SLOW0_PIN
 
-        moviw   FSR1++
-        movwf   SUPPRESS0 + 1
+        bcf     SLOW_PORT, SLOW1_PIN
+        btfsc   WREG, SLOW1_NUM
+        bsf     SLOW_PORT, SLOW1_PIN
 
-        moviw   FSR1++
-        movwf   SUPPRESS0 + 2
+        bcf     SLOW_PORT, SLOW2_PIN
+        btfsc   WREG, SLOW2_NUM
+        bsf     SLOW_PORT, SLOW2_PIN
 
-        moviw   FSR1++
-        movwf   SUPPRESS0 + 3
+        bcf     SLOW_PORT, SLOW3_PIN
+        btfsc   WREG, SLOW3_NUM
+        bsf     SLOW_PORT, SLOW3_PIN
 
-        moviw   FSR1++
-        movwf   SUPPRESS0 + 4
+        bcf     FAST_PORT, FAST0_PIN
+        btfsc   WREG, FAST0_NUM
+        bsf     FAST_PORT, FAST0_PIN
 
-        moviw   FSR1++
-        movwf   SUPPRESS0 + 5
+        bcf     FAST_PORT, FAST1_PIN
+        btfsc   WREG, FAST1_NUM
+        bsf     FAST_PORT, FAST1_PIN
 
-        moviw   FSR1++
-        movwf   SUPPRESS0 + 6
+        bcf     FAST_PORT, FAST2_PIN
+        btfsc   WREG, FAST2_NUM
+        bsf     FAST_PORT, FAST2_PIN
 
-        moviw   FSR1++
-        movwf   SUPPRESS0 + 7
+        bcf     FAST_PORT, FAST3_PIN
+        btfsc   WREG, FAST3_NUM
+        bsf     FAST_PORT, FAST3_PIN
 
-        moviw   FSR1++
-        movwf   DISCARD_CHAR0 + 0
+        movlb   0
 
-        moviw   FSR1++
-        movwf   DISCARD_CHAR0 + 1
+        return
 
-        moviw   FSR1++
-        movwf   DISCARD_CHAR0 + 2
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        moviw   FSR1++
-        movwf   DISCARD_CHAR0 + 3
+;;; Start the interactive mode. Generally, the calls that read from
+;;; the serial port set the zero flag if an error occurs. In this
+;;; case, the last read char is put in W. The functions that read also
+;;; return without doing anything if the zero flag is already
+;;; set. That way a lot of read calls can be made in a row and if one
+;;; of them gets unexpected input, the zero flag is set and W is the
+;;; last wrong char. In this case, the code will go to
+;;; inter_error_just_read that will go to the first newline (which may
+;;; be the last read char in W) and print an error.
+interactive_start:
+        movlw   '\r'
+        btfsc   NEWLINE_FLAGS, NEWLINE_BIT
+        call    write_char
+        movlw   '\n'
+        call    write_char
 
-        moviw   FSR1++
-        movwf   DISCARD_CHAR0 + 4
+        call    wait_100ms
 
-        moviw   FSR1++
-        movwf   DISCARD_CHAR0 + 5
+        movlw   '\r'
+        btfsc   NEWLINE_FLAGS, NEWLINE_BIT
+        call    write_char
+        movlw   '\n'
+        call    write_char
 
-        moviw   FSR1++
-        movwf   DISCARD_CHAR0 + 6
+        call    wait_100ms
 
-        moviw   FSR1++
-        movwf   DISCARD_CHAR0 + 7
+        movlw   '\r'
+        btfsc   NEWLINE_FLAGS, NEWLINE_BIT
+        call    write_char
+        movlw   '\n'
+        call    write_char
 
-        moviw   FSR1++
-        bsf     CHN_OUT_FLAGS, CHN_OUT_BIT
-        btfss   WREG, 0
-        bcf     CHN_OUT_FLAGS, CHN_OUT_BIT
+        call    wait_100ms
 
-        movfw   FAST_FLAGS
-        andlw   0xF0
-        movwf   FAST_FLAGS
-        moviw   FSR1++
-        iorwf   FAST_FLAGS, f
+        movlw   '\n'            ; No return-newline in debug mode
+        call    write_char
 
-        moviw   FSR1++
-        bsf     NEWLINE_FLAGS, NEWLINE_BIT
-        btfss   WREG, 0
-        bcf     NEWLINE_FLAGS, NEWLINE_BIT
+        movlw   '\n'
+        call    write_char
 
-        moviw   FSR1++
-        call    inter_set_invert
+        call    clear_input
 
-        moviw   FSR1++
-        call    inter_set_invert_out
+        call    speed_4800
 
-        moviw   FSR1++
-        movlb   12
-        movwf   INTER_SPEED
-        movlb   0
+        call    is_raspberry
 
-        moviw   FSR1++
-        call    inter_set_schmitt
+        movlw   0x00
+        btfsc   STATUS, C
+        movlw   0x01            ; Set Raspberry Pi mode
 
-        moviw   FSR1++
-        call    inter_set_osctune
+        movwf   INTER_MODE
 
-        return
+        movlb   3
+        btfsc   WREG, 0         ; W is INTER_MODE
+        bsf     RC1STA, CREN    ; Enable receive if Raspberry Pi
+        movlb   0
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        btfsc   INTER_MODE, 0
+        goto    interactive_no_ok ; Raspberry Pi mode, we are done
 
-;;; Save current settings as user settings.
-save_user_settings:
-        call    write_start
+        btfsc   UART_PORT, UART_PIN
+        bsf     INTER_MODE, 1   ; set idle according to current state for stand alone
 
-        movfw   SUPPRESS0 + 0
-        call    save_byte
+        goto    interactive_no_ok
 
-        movfw   SUPPRESS0 + 1
-        call    save_byte
+interactive:                    ; This is where all the following goto's come back to
+        movlw   'O'
+        call    write_char
 
-        movfw   SUPPRESS0 + 2
-        call    save_byte
+        movlw   'k'
+        call    write_char
 
-        movfw   SUPPRESS0 + 3
-        call    save_byte
+        movlw   '\n'
+        call    write_char
 
-        movfw   SUPPRESS0 + 4
-        call    save_byte
+interactive_no_ok:
+        call    read_cmd
 
-        movfw   SUPPRESS0 + 5
-        call    save_byte
+        btfsc   STATUS, Z
+        goto    inter_error_just_read
 
-        movfw   SUPPRESS0 + 6
-        call    save_byte
+        movfw   INTER_VALUE
+        addlw   -'I'
+        btfsc   STATUS, Z
+        goto    inter_cmd_invert
 
-        movfw   SUPPRESS0 + 7
-        call    save_byte
+        addlw   'I' - 'J'
+        btfsc   STATUS, Z
+        goto    inter_cmd_invert_out
 
-        movfw   DISCARD_CHAR0 + 0
-        call    save_byte
+        addlw   'J' - 'C'
+        btfsc   STATUS, Z
+        goto    inter_cmd_channel_output
 
-        movfw   DISCARD_CHAR0 + 1
-        call    save_byte
+        addlw   'C' - 'N'
+        btfsc   STATUS, Z
+        goto    inter_cmd_return_newline
 
-        movfw   DISCARD_CHAR0 + 2
-        call    save_byte
+        addlw   'N' - 'D'
+        btfsc   STATUS, Z
+        goto    inter_cmd_discard
 
-        movfw   DISCARD_CHAR0 + 3
-        call    save_byte
+        addlw   'D' - 'F'
+        btfsc   STATUS, Z
+        goto    inter_cmd_fast
 
-        movfw   DISCARD_CHAR0 + 4
-        call    save_byte
+        addlw   'F' - 'U'
+        btfsc   STATUS, Z
+        goto    inter_cmd_suppress
 
-        movfw   DISCARD_CHAR0 + 5
-        call    save_byte
+        addlw   'U' - 'H'
+        btfsc   STATUS, Z
+        goto    inter_cmd_schmitt
 
-        movfw   DISCARD_CHAR0 + 6
-        call    save_byte
+        addlw   'H' - 'B'
+        btfsc   STATUS, Z
+        goto    inter_cmd_speed
 
-        movfw   DISCARD_CHAR0 + 7
-        call    save_byte
+        addlw   'B' - 'P'
+        btfsc   STATUS, Z
+        goto    inter_cmd_output
 
-        movlw   0x01
-        btfss   CHN_OUT_FLAGS, CHN_OUT_BIT
-        movlw   0x00
-        call    save_byte
+        addlw   'P' - 'G'
+        btfsc   STATUS, Z
+        goto    inter_cmd_debug
 
-        movfw   FAST_FLAGS
-        andlw   0x0F
-        call    save_byte
+        addlw   'G' - 'O'
+        btfsc   STATUS, Z
+        goto    inter_cmd_calibrate
 
-        movlw   0x01
-        btfss   NEWLINE_FLAGS, NEWLINE_BIT
-        movlw   0x00
-        call    save_byte
+        addlw   'O' - 'T'
+        btfsc   STATUS, Z
+        goto    inter_cmd_osctune
 
-        call    inter_get_invert
-        call    save_byte
+        addlw   'T' - 'L'
+        btfsc   STATUS, Z
+        goto    inter_cmd_load
 
-        call    inter_get_invert_out
-        call    save_byte
+        addlw   'L' - 'S'
+        btfsc   STATUS, Z
+        goto    inter_cmd_save
 
-        movlb   12
-        movfw   INTER_SPEED
-        movlb   0
-        call    save_byte
+        addlw   'S' - 'R'
+        btfsc   STATUS, Z
+        goto    inter_cmd_factory
 
-        call    inter_get_schmitt
-        call    save_byte
+        addlw   'R' - 'K'
+        btfsc   STATUS, Z
+        goto    inter_cmd_checksum
 
-        call    inter_get_osctune
-        call    save_last_byte
+        addlw   'K' - 'A'
+        btfsc   STATUS, Z
+        goto    inter_cmd_filter
 
-        return
+inter_error_lp:
+        call    read_char
 
-;;; /////////////////////////////////////////////////////////////////////////////
+inter_error_just_read:          ; goto this place when a wrong char has just been read
+        btfsc   CONFIG_PORT, CONFIG_PIN
+        goto    inter_done
 
-;;; Erase user settings memory and get read to write.
-write_start:
-;;; We erase the user settings by erasing one row of 32 words
-        movlb   3
+        sublw   '\n'
+        btfss   STATUS, Z
+        goto    inter_error_lp
 
-        movlw   LOW(user_settings)
-        movwf   PMADRL
-        movlw   HIGH(user_settings)
-        movwf   PMADRH
+inter_error:
+        btfsc   CONFIG_PORT, CONFIG_PIN
+        goto    inter_done
 
-        bcf     PMCON1, CFGS    ; Normal program memory
-        bsf     PMCON1, FREE    ; Free memory
-        bsf     PMCON1, WREN    ; Write enable
+        movlw   'E'
+        call    write_char
+        movlw   'r'
+        call    write_char
+        movlw   'r'
+        call    write_char
+        movlw   'o'
+        call    write_char
+        movlw   'r'
+        call    write_char
+        movlw   '\n'
+        call    write_char
 
-        movlw   0x55            ; Unlock sequence start
-        movwf   PMCON2
-        movlw   0xAA
-        movwf   PMCON2
-        bsf     PMCON1, WR
-        nop
-        nop                     ; Unlock sequence end
+        goto    interactive_no_ok
 
-;;; Here, we are getting ready to write:
-        movlw   0x34            ; The program instruction written is
-                                ; of type retlw
-        movwf   PMDATH          ; Low byte will be supplied later
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        bsf     PMCON1, LWLO    ; Only output to latches
+;;; Write W as a char to the serial output-
+write_char:
+        btfss   PIR1, TXIF
+        goto    $-1             ; Wait for space in buffer
 
+        movlb   3
+        movwf   TXREG           ; Send char
         movlb   0
 
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Save a byte to program memory latches.
-save_byte:
-        movlb   3
+;;; Convert the last four bits of W to a hex digit in W.
+nibble_to_hex:
+        andlw   0x0F
+        sublw   0x09
+        btfss   STATUS, C
+        addlw   0xF9
+        sublw   0x39
+        return
 
-        movwf   PMDATL          ; High byte already set
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        movlw   0x55            ; Unlock sequence start
-        movwf   PMCON2
-        movlw   0xAA
-        movwf   PMCON2
-        bsf     PMCON1, WR
-        nop
-        nop                     ; Unlock sequence end
+;;; Write W as a hex number to the serial output.
+write_hex:
+        movwf   INTER_TMP
 
-        incf    PMADRL, f
+        swapf   INTER_TMP, W
+        call    nibble_to_hex
+        call    write_char
 
-        movlb   0
+        movfw   INTER_TMP
+        call    nibble_to_hex
+        call    write_char
 
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Save a byte along with previous latches to program memory.
-save_last_byte:
+;;; Clear the serial port of input.
+clear_input:
         movlb   3
-        bcf     PMCON1, LWLO    ; Store to everything memory
-        movlb   0
 
-        call    save_byte
+        movfw   RC1REG          ; The buffer is small, so four reads is ok
+        movfw   RC1REG
+        movfw   RC1REG
+        movfw   RC1REG
 
-        movlb   3
-        bcf     PMCON1, WREN    ; Disable write
         movlb   0
 
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Set W according to which channels are inverted.
-inter_get_invert:
-        clrw
+;;; This function reads ten 'U' characters from the UART input and
+;;; counts clock cycles per two bits 40 times. These cycle counts are
+;;; output on UART after the measurements for use in calibrating the
+;;; oscillator. The zero flag is set on error.
+calibrate_clock:
+        btfsc   INTER_MODE, 0
+        bcf     RC1STA, CREN    ; Disable receive if Raspberry Pi since we read manually
 
-        btfsc   INVERT_S, SLOW0_PIN
-        bsf     WREG, SLOW0_NUM
+        movlw   0x01
+        movwf   FSR1H
+        movlw   0x20
+        movwf   FSR1L           ; use bank 2 for storing results
 
-        btfsc   INVERT_S, SLOW1_PIN
-        bsf     WREG, SLOW1_NUM
+        movlw   0x0A
+        movwf   INTER_TMP2      ; 10 rounds
+calibrate_lp:
+        call    read_U_timed
+        btfsc   STATUS, Z
+        goto    calibrate_err  ; Zero flag set indicating error
 
-        btfsc   INVERT_S, SLOW2_PIN
-        bsf     WREG, SLOW2_NUM
+        decfsz  INTER_TMP2, f
+        goto    calibrate_lp
 
-        btfsc   INVERT_S, SLOW3_PIN
-        bsf     WREG, SLOW3_NUM
+        ;; We now have 40 timing measurements
 
-        btfsc   INVERT_F, FAST0_PIN
-        bsf     WREG, FAST0_NUM
+        btfsc   INTER_MODE, 0
+        bsf     RC1STA, CREN    ; Enable receive if Raspberry Pi
 
-        btfsc   INVERT_F, FAST1_PIN
-        bsf     WREG, FAST1_NUM
+        call    clear_input     ; Get rid of any 'U's read by the built in UART if Raspberry Pi
 
-        btfsc   INVERT_F, FAST2_PIN
-        bsf     WREG, FAST2_NUM
+        bcf     STATUS, Z       ; Indicate to read_newline that no error has occurred
+        call    read_newline
+        btfsc   STATUS, Z
+        goto    calibrate_err2
 
-        btfsc   INVERT_F, FAST3_PIN
-        bsf     WREG, FAST3_NUM
+        movlw   0x01
+        movwf   FSR1H
+        movlw   0x20
+        movwf   FSR1L           ; reset pointer
 
-        return
+        movlw   0x28
+        movwf   INTER_TMP2      ; 40 rounds
+calibrate_print_lp:
+        moviw   FSR1++
+        call    write_hex
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        moviw   FSR1++
+        call    write_hex
 
-;;; Set which channels are inverted from W.
-inter_set_invert:
-        clrf    INVERT_S
+        movlw   '\n'
+        call    write_char
 
-        btfsc   WREG, SLOW0_NUM
-        bsf     INVERT_S, SLOW0_PIN
+        decfsz  INTER_TMP2, f
+        goto    calibrate_print_lp
 
-        btfsc   WREG, SLOW1_NUM
-        bsf     INVERT_S, SLOW1_PIN
+calibrate_done:
+        btfsc   INTER_MODE, 0
+        bsf     RC1STA, CREN    ; Enable receive if Raspberry Pi
 
-        btfsc   WREG, SLOW2_NUM
-        bsf     INVERT_S, SLOW2_PIN
+        call    wait_100ms
 
-        btfsc   WREG, SLOW3_NUM
-        bsf     INVERT_S, SLOW3_PIN
+        call    clear_input     ; Clear input (only matters if Raspberry Pi)
 
-        clrf    INVERT_F
+        bcf     STATUS, Z       ; indicate success
 
-        btfsc   WREG, FAST0_NUM
-        bsf     INVERT_F, FAST0_PIN
+        return
 
-        btfsc   WREG, FAST1_NUM
-        bsf     INVERT_F, FAST1_PIN
+calibrate_err:
+        btfsc   INTER_MODE, 0
+        bsf     RC1STA, CREN    ; Enable receive if Raspberry Pi
 
-        btfsc   WREG, FAST2_NUM
-        bsf     INVERT_F, FAST2_PIN
+calibrate_err2:
+        call    wait_100ms
 
-        btfsc   WREG, FAST3_NUM
-        bsf     INVERT_F, FAST3_PIN
+        call    clear_input     ; Clear input (only matters if Raspberry Pi)
+
+        bsf     STATUS, Z       ; indicate error
 
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Set W according to whether output is inverted.
-inter_get_invert_out:
-        movlb   3
+;;; Reads a 'U' character from the UART while making clock cycle
+;;; measurements. This is a 'U' character:
+;;;   ____    __    __    __    __    __________
+;;;       |__|  |__|  |__|  |__|  |__|
+;;;      start 1  0  1  0  1  0  1  0  stop
+;;;
+;;;          |<--->|<--->|<--->|<--->|  four time measurements
+;;;
+;;; The zero flag is set on error.
+read_U_timed:
+        ;; Wait for start bit, precision is not that important
+        bsf     STATUS, Z       ; if an error should occur
+read_U_start_lp:
+        btfsc   CONFIG_PORT, CONFIG_PIN
+        return                  ; return error if CONFIG signal high (should not be in interactive mode)
+        call    get_bit
+        btfsc   STATUS, C       ; waiting for zero bit (start)
+        goto    read_U_start_lp
 
-        movlw   0x00
-        btfsc   BAUD1CON, SCKP
-        movlw   0x01
+        ;; Now, get the bits one at a time, measuring appropriate times
 
-        movlb   0
+        call    wait_for_one
+        btfsc   STATUS, Z
+        return
+
+        call    store_time
 
+        movfw   INTER_TM1H
+        movwf   INTER_TM2H
+        movfw   INTER_TM1L
+        movwf   INTER_TM2L      ; INTER_TM2H:L is now the stored wall time
+
+        nop                     ; adjust timing modulo 3 between store_time calls
+        nop
+
+        movlw   0x04
+        movwf   INTER_TMP       ; Counter for reads of bit
+read_U_lp:
+        call    wait_for_zero
+        btfsc   STATUS, Z
         return
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        call    wait_for_one
+        btfsc   STATUS, Z
+        return
 
-;;; Set output is inversion according to W.
-inter_set_invert_out:
-        movlb   3
+        call    store_time
 
-        bcf     BAUD1CON, SCKP
-        btfsc   WREG, 0
-        bsf     BAUD1CON, SCKP
+        movfw   INTER_TM2L
+        subwf   INTER_TM1L, W
+        movwi   ++FSR1          ; store low byte in second position
+        movfw   INTER_TM2H
+        subwfb  INTER_TM1H, W
+        movwi   -1[FSR1]        ; store high byte in second position
+        incf    FSR1L, f
 
-        movlb   0
+        movfw   INTER_TM1H
+        movwf   INTER_TM2H
+        movfw   INTER_TM1L
+        movwf   INTER_TM2L      ; INTER_TM2H:L is now the stored wall time
+
+        decfsz  INTER_TMP, f
+        goto    read_U_lp
+
+        bcf     STATUS, Z       ; indicate success
 
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Set W according to OSCTUNE.
-inter_get_osctune:
-        movlb   1
-        movfw   OSCTUNE
-        movlb   0
+;;; Save current time from timer1 to INTER_TM1H:L.
+store_time:
+        movfw   TMR1H
+        movwf   INTER_TM1H
+        movfw   TMR1L
+        movwf   INTER_TM1L
+
+        lsrf    INTER_TM1L, W
+        btfsc   STATUS, Z
+        incf    INTER_TM1H, f         ; Adjust for two cycle difference in reading high/low timer parts
 
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Set OSCTUNE according to W.
-inter_set_osctune
-        movlb   1
-        movwf   OSCTUNE
-        movlb   0
+;;; 13 cycles including call and return. Get the input bit value at
+;;; cycle 9 of 13 including call and return. INTER_MODE is taken into
+;;; account.
+get_bit:
+        bsf     STATUS, C
+        btfsc   INTER_MODE, 0
+        goto    get_bit_rpi
 
-        return
+get_bit_man:                    ; 3 cycles to here
+        btfss   INTER_MODE, 1
+        goto    get_bit_man_idle_low
 
-;;; /////////////////////////////////////////////////////////////////////////////
+get_bit_man_idle_high:          ; 5 cycles to here
+        nop                     ; adjust timing
+        btfss   UART_PORT, UART_PIN
+        bcf     STATUS, C
+        return                  ; 9 cycles to here
 
-;;; Set W according to which channels are using Schmitt triggers.
-inter_get_schmitt:
-        clrw
+get_bit_man_idle_low:           ; 6 cycles to here
+        btfsc   UART_PORT, UART_PIN
+        bcf     STATUS, C
+        return                  ; 9 cycles to here
 
-        movlb   7
+get_bit_rpi:                    ; 4 cycles to here
+        nop                     ; adjust timing
+        nop                     ; adjust timing
+        btfss   UART2_PORT, UART2_PIN
+        bcf     STATUS, C
+        return                  ; 9 cycles to here
 
-;;; In the following cade, SLOW_PORT and FAST_PORT refers to the
-;;; appropriate INLVLA/C registers since we are in bank 7.
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        btfsc   SLOW_PORT, SLOW0_PIN
-        bsf     WREG, SLOW0_NUM
+;;; Wait for a one bit using the in_wait macro. Adjust for INTER_MODE.
+;;; Zero flag set on error.
+wait_for_one:
+        btfsc   INTER_MODE, 0
+        goto    wait_for_one_rpi
 
-        btfsc   SLOW_PORT, SLOW1_PIN
-        bsf     WREG, SLOW1_NUM
+wait_for_one_man:
+        btfss   INTER_MODE, 1
+        goto    wait_for_one_man_idle_low
 
-        btfsc   SLOW_PORT, SLOW2_PIN
-        bsf     WREG, SLOW2_NUM
+wait_for_one_man_idle_high:
+        nop                     ; adjust timing
 
-        btfsc   SLOW_PORT, SLOW3_PIN
-        bsf     WREG, SLOW3_NUM
+        call    wait_for_uart_high ; idle is one
 
-        btfsc   FAST_PORT, FAST0_PIN
-        bsf     WREG, FAST0_NUM
+        return
 
-        btfsc   FAST_PORT, FAST1_PIN
-        bsf     WREG, FAST1_NUM
+wait_for_one_man_idle_low:
+        call    wait_for_uart_low
 
-        btfsc   FAST_PORT, FAST2_PIN
-        bsf     WREG, FAST2_NUM
+        return
 
-        btfsc   FAST_PORT, FAST3_PIN
-        bsf     WREG, FAST3_NUM
+wait_for_one_rpi:
+        nop                     ; adjust timing
+        nop                     ; adjust timing
 
-        movlb   0
+        call    wait_for_uart2_high
 
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Set which channels are using Schmitt triggers from W.
-inter_set_schmitt:
-        movlb   7
+;;; Wait for a zero bit using the in_wait macro. Adjust for
+;;; INTER_MODE. Zero flag set on error.
+wait_for_zero:
+        btfsc   INTER_MODE, 0
+        goto    wait_for_zero_rpi
 
-;;; In the following cade, SLOW_PORT and FAST_PORT refers to the
-;;; appropriate INLVLA/C registers since we are in bank 7.
+wait_for_zero_man:
+        btfss   INTER_MODE, 1
+        goto    wait_for_zero_man_idle_low
 
-        bcf     SLOW_PORT, SLOW0_PIN
-        btfsc   WREG, SLOW0_NUM
-        bsf     SLOW_PORT, SLOW0_PIN
+wait_for_zero_man_idle_high:
+        nop                     ; adjust timing
 
-        bcf     SLOW_PORT, SLOW1_PIN
-        btfsc   WREG, SLOW1_NUM
-        bsf     SLOW_PORT, SLOW1_PIN
+        call    wait_for_uart_low ; idle is one
 
-        bcf     SLOW_PORT, SLOW2_PIN
-        btfsc   WREG, SLOW2_NUM
-        bsf     SLOW_PORT, SLOW2_PIN
+        return
 
-        bcf     SLOW_PORT, SLOW3_PIN
-        btfsc   WREG, SLOW3_NUM
-        bsf     SLOW_PORT, SLOW3_PIN
+wait_for_zero_man_idle_low:
+        call    wait_for_uart_high
 
-        bcf     FAST_PORT, FAST0_PIN
-        btfsc   WREG, FAST0_NUM
-        bsf     FAST_PORT, FAST0_PIN
+        return
 
-        bcf     FAST_PORT, FAST1_PIN
-        btfsc   WREG, FAST1_NUM
-        bsf     FAST_PORT, FAST1_PIN
+wait_for_zero_rpi:
+        nop                     ; adjust timing
+        nop                     ; adjust timing
 
-        bcf     FAST_PORT, FAST2_PIN
-        btfsc   WREG, FAST2_NUM
-        bsf     FAST_PORT, FAST2_PIN
+        call    wait_for_uart2_low
 
-        bcf     FAST_PORT, FAST3_PIN
-        btfsc   WREG, FAST3_NUM
-        bsf     FAST_PORT, FAST3_PIN
+        return
 
-        movlb   0
+;;; /////////////////////////////////////////////////////////////////////////////
 
+;;; Wait for low signal on UART using in_wait macro.
+wait_for_uart_low:
+        in_wait UART_PORT, UART_PIN, 0
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Start the interactive mode. Generally, the calls that read from
-;;; the serial port set the zero flag if an error occurs. In this
-;;; case, the last read char is put in W. The functions that read also
-;;; return without doing anything if the zero flag is already
-;;; set. That way a lot of read calls can be made in a row and if one
-;;; of them gets unexpected input, the zero flag is set and W is the
-;;; last wrong char. In this case, the code will go to
-;;; inter_error_just_read that will go to the first newline (which may
-;;; be the last read char in W) and print an error.
-interactive_start:
-        movlw   '\r'
-        btfsc   NEWLINE_FLAGS, NEWLINE_BIT
-        call    write_char
-        movlw   '\n'
-        call    write_char
+;;; Wait for high signal on UART using in_wait macro.
+wait_for_uart_high:
+        in_wait UART_PORT, UART_PIN, 1
+        return
 
-        call    wait_100ms
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        movlw   '\r'
-        btfsc   NEWLINE_FLAGS, NEWLINE_BIT
-        call    write_char
-        movlw   '\n'
-        call    write_char
+;;; Wait for low signal on UART2 using in_wait macro.
+wait_for_uart2_low:
+        in_wait UART2_PORT, UART2_PIN, 0
+        return
 
-        call    wait_100ms
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        movlw   '\r'
-        btfsc   NEWLINE_FLAGS, NEWLINE_BIT
-        call    write_char
-        movlw   '\n'
-        call    write_char
+;;; Wait for high signal on UART2 using in_wait macro.
+wait_for_uart2_high:
+        in_wait UART2_PORT, UART2_PIN, 1
+        return
 
-        call    wait_100ms
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        movlw   '\n'            ; No return-newline in debug mode
-        call    write_char
+;;; Manually read a character from an input channel. Carry flag set on
+;;; success.
+read_char_man:
+        bcf     STATUS, C       ; indicate an error in case we return early
 
-        movlw   '\n'
-        call    write_char
+        btfsc   INTER_MODE, 1
+        goto    read_char_man_lp_idle_high
 
-        call    clear_input
+read_char_man_lp_idle_low:
+        btfsc   CONFIG_PORT, CONFIG_PIN
+        return                  ; Return error if CONFIG signal high (should not be in interactive mode)
 
-        call    speed_4800
+        btfss   UART_PORT, UART_PIN
+        goto    read_char_man_lp_idle_low
 
-        call    is_raspberry
+        goto    read_char_man_ready
 
-        movlw   0x00
-        btfsc   STATUS, C
-        movlw   0x01            ; Set Raspberry Pi mode
+read_char_man_lp_idle_high:
+        btfsc   CONFIG_PORT, CONFIG_PIN
+        return                  ; Return error if CONFIG signal high (should not be in interactive mode)
 
-        movwf   INTER_MODE
+        btfsc   UART_PORT, UART_PIN
+        goto    read_char_man_lp_idle_high
 
-        movlb   3
-        btfsc   WREG, 0         ; W is INTER_MODE
-        bsf     RC1STA, CREN    ; Enable receive if Raspberry Pi
-        movlb   0
+        nop                     ; to get the same timing as when idle is low
+        nop
 
-        btfsc   INTER_MODE, 0
-        goto    interactive_no_ok ; Raspberry Pi mode, we are done
+read_char_man_ready:
+        call    read_first_bit  ; wait half an input cycle before reading
+        btfsc   STATUS, C
+        goto    read_char_man_err ; first bit should be zero
 
-        btfsc   UART_PORT, UART_PIN
-        bsf     INTER_MODE, 1   ; set idle according to current state for stand alone
+        movlw   0x80
+        movwf   INTER_CHAR
 
-        goto    interactive_no_ok
+read_char_man_next:
+        call    read_bit        ; 1667 cycles between calls
+        rrf     INTER_CHAR, f
 
-interactive:                    ; This is where all the following goto's come back to
-        movlw   'O'
-        call    write_char
+        btfss   STATUS, C       ; this is the bit that was put in to start with
+        goto    read_char_man_next
 
-        movlw   'k'
-        call    write_char
+        nop
 
-        movlw   '\n'
-        call    write_char
+        call    read_bit
 
-interactive_no_ok:
-        call    read_cmd
+        ;; Carry flag is set when the stop bit is a one like it should be
 
-        btfsc   STATUS, Z
-        goto    inter_error_just_read
+        movfw   INTER_CHAR
 
-        movfw   INTER_VALUE
-        addlw   -'I'
-        btfsc   STATUS, Z
-        goto    inter_cmd_invert
+        return
 
-        addlw   'I' - 'J'
-        btfsc   STATUS, Z
-        goto    inter_cmd_invert_out
+read_char_man_err:
+        clrw
+
+        bcf     STATUS, C       ; clear carry to indicate error
 
-        addlw   'J' - 'C'
-        btfsc   STATUS, Z
-        goto    inter_cmd_channel_output
+        return
 
-        addlw   'C' - 'N'
-        btfsc   STATUS, Z
-        goto    inter_cmd_return_newline
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        addlw   'N' - 'D'
-        btfsc   STATUS, Z
-        goto    inter_cmd_discard
+;;; 1662 cycles including call and return. Read a bit and put it in carry flag.
+read_bit:
+        movlw   0xD0
 
-        addlw   'D' - 'F'
-        btfsc   STATUS, Z
-        goto    inter_cmd_fast
+read_bit_lp1:
+        nop
+        decfsz  WREG, f
+        goto    read_bit_lp1    ; 4 cycles per iteration
 
-        addlw   'F' - 'U'
-        btfsc   STATUS, Z
-        goto    inter_cmd_suppress
+        nop
 
-        addlw   'U' - 'H'
-        btfsc   STATUS, Z
-        goto    inter_cmd_schmitt
+read_first_bit:                 ; 833 cycles to here
 
-        addlw   'H' - 'B'
-        btfsc   STATUS, Z
-        goto    inter_cmd_speed
+        movlw   0xCC
 
-        addlw   'B' - 'P'
-        btfsc   STATUS, Z
-        goto    inter_cmd_output
+read_bit_lp2:
+        nop
+        decfsz  WREG, f
+        goto    read_bit_lp2    ; 4 cycles per iteration
 
-        addlw   'P' - 'G'
-        btfsc   STATUS, Z
-        goto    inter_cmd_debug
+        ;; 1649 cycles to here
 
-        addlw   'G' - 'O'
-        btfsc   STATUS, Z
-        goto    inter_cmd_calibrate
+        bsf     STATUS, C       ; idle is one bit
 
-        addlw   'O' - 'T'
-        btfsc   STATUS, Z
-        goto    inter_cmd_osctune
+        btfss   INTER_MODE, 1
+        goto    read_bit_idle_low
 
-        addlw   'T' - 'L'
-        btfsc   STATUS, Z
-        goto    inter_cmd_load
+        nop
+        btfss   UART_PORT, UART_PIN ; read at 1655 of 1662 cycles from call
+        bcf     STATUS, C
 
-        addlw   'L' - 'S'
-        btfsc   STATUS, Z
-        goto    inter_cmd_save
+        goto    vreturn_in_4    ; 1659 cycles to here
 
-        addlw   'S' - 'R'
-        btfsc   STATUS, Z
-        goto    inter_cmd_factory
+read_bit_idle_low:
+        btfsc   UART_PORT, UART_PIN ; read at 1655 of 1662 cycles from call
+        bcf     STATUS, C
 
-inter_error_lp:
-        call    read_char
+        goto    vreturn_in_4    ; 1659 cycles to here
 
-inter_error_just_read:          ; goto this place when a wrong char has just been read
-        btfsc   CONFIG_PORT, CONFIG_PIN
-        goto    inter_done
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        sublw   '\n'
-        btfss   STATUS, Z
-        goto    inter_error_lp
+;;; Read a character from the serial port.
+read_char:
+        btfss   INTER_MODE, 0
+        goto    read_char_man   ; Read manually for stand alone board
 
-inter_error:
-        btfsc   CONFIG_PORT, CONFIG_PIN
-        goto    inter_done
+        movlb   3
 
-        movlw   'E'
-        call    write_char
-        movlw   'r'
-        call    write_char
-        movlw   'r'
-        call    write_char
-        movlw   'o'
-        call    write_char
-        movlw   'r'
-        call    write_char
-        movlw   '\n'
-        call    write_char
+        btfsc   RC1STA, OERR
+        bcf     RC1STA, CREN    ; Clear CREN on error
+        bsf     RC1STA, CREN
 
-        goto    interactive_no_ok
+        movlb   0
 
-;;; /////////////////////////////////////////////////////////////////////////////
+read_char_lp:
+        btfsc   CONFIG_PORT, CONFIG_PIN
+        return                  ; Return if CONFIG signal high (should not be in interactive mode)
 
-;;; Write W as a char to the serial output-
-write_char:
-        btfss   PIR1, TXIF
-        goto    $-1             ; Wait for space in buffer
+        btfss   PIR1, RCIF
+        goto    read_char_lp    ; Wait for data
 
         movlb   3
-        movwf   TXREG           ; Send char
+        movfw   RC1REG
         movlb   0
 
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Convert the last four bits of W to a hex digit in W.
-nibble_to_hex:
-        andlw   0x0F
-        sublw   0x09
-        btfss   STATUS, C
-        addlw   0xF9
-        sublw   0x39
-        return
+;;; Read an input command.
+read_cmd:
+        call    read_char
+
+        bsf     STATUS, Z
+        btfsc   CONFIG_PORT, CONFIG_PIN
+        return                  ; Return error if CONFIG signal high (should not be in interactive mode)
+
+        movwf   INTER_VALUE
+        sublw   '\n'
+        btfss   STATUS, Z
+        return                  ; Success
+        sublw   '\n'            ; Set W to the originally read char (\n)
+        bsf     STATUS, Z
+        return                  ; Error
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Write W as a hex number to the serial output.
-write_hex:
-        movwf   INTER_TMP
+;;; Read a number from 0 to W (included and <= 9), put it in W.
+read_num:
+        btfsc   STATUS, Z
+        return
 
-        swapf   INTER_TMP, W
-        call    nibble_to_hex
-        call    write_char
+        movwf   INTER_TMP
+        call    read_char
+        addlw   -'0'
+        subwf   INTER_TMP, W
+        btfss   STATUS, C
+        goto    read_num_error
 
-        movfw   INTER_TMP
-        call    nibble_to_hex
-        call    write_char
+read_num_success:
+        subwf   INTER_TMP, W
+        bcf     STATUS, Z
+        return                  ; Success
 
-        return
+read_num_error:
+        subwf   INTER_TMP, W    ; Restore W to read char
+        addlw   '0'
+        bsf     STATUS, Z
+        return                  ; Error
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Clear the serial port of input.
-clear_input:
-        movlb   3
+;;; Read an input character of 1-8 and return 0-7 (i.e. one less).
+read_channel:
+        movlw   8
+        call    read_num
+        btfsc   STATUS, Z
+        return                  ; Error
 
-        movfw   RC1REG          ; The buffer is small, so four reads is ok
-        movfw   RC1REG
-        movfw   RC1REG
-        movfw   RC1REG
+        addlw   0xFF            ; Subtract one
+        bcf     STATUS, Z
+        btfsc   STATUS, C
+        return                  ; Success
 
-        movlb   0
+        bsf     STATUS, Z       ; We have read '0' which is not a channel
+        movlw   '0'             ; Restore W to read char
+        return                  ; Error
+
+;;; /////////////////////////////////////////////////////////////////////////////
 
+;;; Read a single hex number and put it in W.
+read_hex_sgl:
+        btfsc   STATUS, Z
         return
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        call    read_char
+        addlw   -'A'
+        btfsc   STATUS, C
+        goto    read_hex_A_F
 
-;;; This function reads ten 'U' characters from the UART input and
-;;; counts clock cycles per two bits 40 times. These cycle counts are
-;;; output on UART after the measurements for use in calibrating the
-;;; oscillator. The zero flag is set on error.
-calibrate_clock:
-        btfsc   INTER_MODE, 0
-        bcf     RC1STA, CREN    ; Disable receive if Raspberry Pi since we read manually
+read_hex_0_9:
+        addlw   'A'-'0'
+        sublw   9
+        btfss   STATUS, C
+        goto    read_hex_error_0_9
+        sublw   9
+        bcf     STATUS, Z
+        return
 
-        movlw   0x01
-        movwf   FSR1H
-        movlw   0x20
-        movwf   FSR1L           ; use bank 2 for storing results
+read_hex_error_0_9:
+        sublw   9               ; Restore W to read char
+        addlw   '0'
+        bsf     STATUS, Z
+        return
 
-        movlw   0x0A
-        movwf   INTER_TMP2      ; 10 rounds
-calibrate_lp:
-        call    read_U_timed
-        btfsc   STATUS, Z
-        goto    calibrate_err  ; Zero flag set indicating error
+read_hex_A_F:
+        sublw   5
+        btfss   STATUS, C
+        goto    read_hex_error_A_F
+        sublw   5
+        addlw   0x0A
+        bcf     STATUS, Z
+        return
 
-        decfsz  INTER_TMP2, f
-        goto    calibrate_lp
+read_hex_error_A_F:
+        sublw   5
+        addlw   'A'
+        bsf     STATUS, Z
+        return
 
-        ;; We now have 40 timing measurements
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        btfsc   INTER_MODE, 0
-        bsf     RC1STA, CREN    ; Enable receive if Raspberry Pi
+;;; Read a double digit hex number and put it in W.
+read_hex_dbl:
+        btfsc   STATUS, Z
+        return
+
+        call    read_hex_sgl
+        movwf   INTER_TMP
 
-        call    clear_input     ; Get rid of any 'U's read by the built in UART if Raspberry Pi
+        call    read_hex_sgl
 
-        bcf     STATUS, Z       ; Indicate to read_newline that no error has occurred
-        call    read_newline
         btfsc   STATUS, Z
-        goto    calibrate_err2
+        return
 
-        movlw   0x01
-        movwf   FSR1H
-        movlw   0x20
-        movwf   FSR1L           ; reset pointer
+        swapf   INTER_TMP, f
+        iorwf   INTER_TMP, W
 
-        movlw   0x28
-        movwf   INTER_TMP2      ; 40 rounds
-calibrate_print_lp:
-        moviw   FSR1++
-        call    write_hex
+        bcf     STATUS, Z
+        return
 
-        moviw   FSR1++
-        call    write_hex
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        movlw   '\n'
-        call    write_char
+;;; Read a newline (or return followed by newline). Zero flag is set
+;;; on error.
+read_newline:
+        btfsc   STATUS, Z
+        return
 
-        decfsz  INTER_TMP2, f
-        goto    calibrate_print_lp
+        call    read_char
+        sublw   '\n'
+        btfss   STATUS, Z
+        goto    read_newline_error
 
-calibrate_done:
-        btfsc   INTER_MODE, 0
-        bsf     RC1STA, CREN    ; Enable receive if Raspberry Pi
+read_newline_success:
+        bcf     STATUS, Z
+        return
 
-        call    wait_100ms
+read_newline_error:
+        sublw   '\n'
+        sublw   '\r'
+        btfsc   STATUS, Z
+        goto    read_newline_return ; We read a return
 
-        call    clear_input     ; Clear input (only matters if Raspberry Pi)
+        sublw   '\r'            ; Restore W to read char
+        bsf     STATUS, Z       ; Return error
+        return
 
-        bcf     STATUS, Z       ; indicate success
+read_newline_return:
+        bcf     STATUS, Z       ; Clear error and try again
+        goto    read_newline
+
+;;; /////////////////////////////////////////////////////////////////////////////
 
+;;; Read an address filter action, 'A' (allow) or 'D' (deny), and put
+;;; 1 or 0 in W.
+read_filter_action:
+        btfsc   STATUS, Z
         return
 
-calibrate_err:
-        btfsc   INTER_MODE, 0
-        bsf     RC1STA, CREN    ; Enable receive if Raspberry Pi
+        call    read_char
+        movwf   INTER_TMP
 
-calibrate_err2:
-        call    wait_100ms
+        sublw   'D'
+        btfsc   STATUS, Z
+        goto    read_filter_action_success ; W is zero
 
-        call    clear_input     ; Clear input (only matters if Raspberry Pi)
+        movfw   INTER_TMP
+        sublw   'A'
+        movlw   1
+        btfsc   STATUS, Z
+        goto    read_filter_action_success
 
-        bsf     STATUS, Z       ; indicate error
+        movfw   INTER_TMP       ; Restore W to read char
+        bsf     STATUS, Z
+        return                  ; Error
 
-        return
+read_filter_action_success:
+        bcf     STATUS, Z
+        return                  ; Success
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Reads a 'U' character from the UART while making clock cycle
-;;; measurements. This is a 'U' character:
-;;;   ____    __    __    __    __    __________
-;;;       |__|  |__|  |__|  |__|  |__|
-;;;      start 1  0  1  0  1  0  1  0  stop
-;;;
-;;;          |<--->|<--->|<--->|<--->|  four time measurements
-;;;
-;;; The zero flag is set on error.
-read_U_timed:
-        ;; Wait for start bit, precision is not that important
-        bsf     STATUS, Z       ; if an error should occur
-read_U_start_lp:
-        btfsc   CONFIG_PORT, CONFIG_PIN
-        return                  ; return error if CONFIG signal high (should not be in interactive mode)
-        call    get_bit
-        btfsc   STATUS, C       ; waiting for zero bit (start)
-        goto    read_U_start_lp
-
-        ;; Now, get the bits one at a time, measuring appropriate times
-
-        call    wait_for_one
+;;; Read an address filter pattern char and put it in W the way it is
+;;; stored in FLT_PAT: zero for '?' and the char with bit 7 set
+;;; otherwise.
+read_filter_char:
         btfsc   STATUS, Z
         return
 
-        call    store_time
+        call    read_char
+        movwf   INTER_TMP
 
-        movfw   INTER_TM1H
-        movwf   INTER_TM2H
-        movfw   INTER_TM1L
-        movwf   INTER_TM2L      ; INTER_TM2H:L is now the stored wall time
+        addlw   -'!'
+        sublw   '~' - '!'
+        btfss   STATUS, C
+        goto    read_filter_char_error ; Not a printable char
 
-        nop                     ; adjust timing modulo 3 between store_time calls
-        nop
+        movfw   INTER_TMP
+        iorlw   0x80
+        xorlw   '?' | 0x80
+        btfss   STATUS, Z
+        xorlw   '?' | 0x80      ; Restore char with bit 7 set, unless it was '?'
 
-        movlw   0x04
-        movwf   INTER_TMP       ; Counter for reads of bit
-read_U_lp:
-        call    wait_for_zero
-        btfsc   STATUS, Z
-        return
+        bcf     STATUS, Z
+        return                  ; Success
 
-        call    wait_for_one
-        btfsc   STATUS, Z
-        return
+read_filter_char_error:
+        movfw   INTER_TMP       ; Restore W to read char
+        bsf     STATUS, Z
+        return                  ; Error
 
-        call    store_time
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        movfw   INTER_TM2L
-        subwf   INTER_TM1L, W
-        movwi   ++FSR1          ; store low byte in second position
-        movfw   INTER_TM2H
-        subwfb  INTER_TM1H, W
-        movwi   -1[FSR1]        ; store high byte in second position
-        incf    FSR1L, f
+;;; Point FSR1 to address filter slot W (0-7).
+filter_slot_ptr:
+        movwf   INTER_TMP
+        incf    INTER_TMP, f
 
-        movfw   INTER_TM1H
-        movwf   INTER_TM2H
-        movfw   INTER_TM1L
-        movwf   INTER_TM2L      ; INTER_TM2H:L is now the stored wall time
+        movlw   HIGH(FLT_PAT)
+        movwf   FSR1H
+        movlw   LOW(FLT_PAT) - FLT_SLOT_SIZE
+        movwf   FSR1L
 
+        movlw   FLT_SLOT_SIZE
+filter_slot_ptr_lp:
+        addwf   FSR1L, f
         decfsz  INTER_TMP, f
-        goto    read_U_lp
-
-        bcf     STATUS, Z       ; indicate success
+        goto    filter_slot_ptr_lp
 
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Save current time from timer1 to INTER_TM1H:L.
-store_time:
-        movfw   TMR1H
-        movwf   INTER_TM1H
-        movfw   TMR1L
-        movwf   INTER_TM1L
+;;; A number of functions for all the commands-
+inter_cmd_channel_output:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
+
+        movlw   1
+        call    read_num
+        movwf   INTER_VALUE
+
+        call    read_newline
 
-        lsrf    INTER_TM1L, W
         btfsc   STATUS, Z
-        incf    INTER_TM1H, f         ; Adjust for two cycle difference in reading high/low timer parts
+        goto    inter_error_just_read
 
-        return
+        bsf     CHN_OUT_FLAGS, CHN_OUT_BIT
+        btfss   INTER_VALUE, 0
+        bcf     CHN_OUT_FLAGS, CHN_OUT_BIT
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        goto    interactive
 
-;;; 13 cycles including call and return. Get the input bit value at
-;;; cycle 9 of 13 including call and return. INTER_MODE is taken into
-;;; account.
-get_bit:
-        bsf     STATUS, C
-        btfsc   INTER_MODE, 0
-        goto    get_bit_rpi
+;;; //////////
 
-get_bit_man:                    ; 3 cycles to here
-        btfss   INTER_MODE, 1
-        goto    get_bit_man_idle_low
+inter_cmd_fast:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
 
-get_bit_man_idle_high:          ; 5 cycles to here
-        nop                     ; adjust timing
-        btfss   UART_PORT, UART_PIN
-        bcf     STATUS, C
-        return                  ; 9 cycles to here
+        call    read_hex_sgl
+        movwf   INTER_VALUE
 
-get_bit_man_idle_low:           ; 6 cycles to here
-        btfsc   UART_PORT, UART_PIN
-        bcf     STATUS, C
-        return                  ; 9 cycles to here
+        call    read_newline
 
-get_bit_rpi:                    ; 4 cycles to here
-        nop                     ; adjust timing
-        nop                     ; adjust timing
-        btfss   UART2_PORT, UART2_PIN
-        bcf     STATUS, C
-        return                  ; 9 cycles to here
+        btfsc   STATUS, Z
+        goto    inter_error_just_read
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        movfw   FAST_FLAGS
+        andlw   0xF0
+        iorwf   INTER_VALUE, W
+        movwf   FAST_FLAGS
 
-;;; Wait for a one bit using the in_wait macro. Adjust for INTER_MODE.
-;;; Zero flag set on error.
-wait_for_one:
-        btfsc   INTER_MODE, 0
-        goto    wait_for_one_rpi
+        goto    interactive
 
-wait_for_one_man:
-        btfss   INTER_MODE, 1
-        goto    wait_for_one_man_idle_low
+;;; //////////
 
-wait_for_one_man_idle_high:
-        nop                     ; adjust timing
+inter_cmd_return_newline:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
 
-        call    wait_for_uart_high ; idle is one
+        movlw   1
+        call    read_num
+        movwf   INTER_VALUE
 
-        return
+        call    read_newline
 
-wait_for_one_man_idle_low:
-        call    wait_for_uart_low
+        btfsc   STATUS, Z
+        goto    inter_error_just_read
 
-        return
+        bsf     NEWLINE_FLAGS, NEWLINE_BIT
+        btfss   INTER_VALUE, 0
+        bcf     NEWLINE_FLAGS, NEWLINE_BIT
 
-wait_for_one_rpi:
-        nop                     ; adjust timing
-        nop                     ; adjust timing
+        goto    interactive
 
-        call    wait_for_uart2_high
+;;; //////////
 
-        return
+inter_cmd_invert:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
+
+        call    read_hex_dbl
+        movwf   INTER_VALUE
+
+        call    read_newline
+
+        btfsc   STATUS, Z
+        goto    inter_error_just_read
+
+        movfw   INTER_VALUE
+        call    inter_set_invert
+
+        goto    interactive
+
+;;; //////////
 
-;;; /////////////////////////////////////////////////////////////////////////////
+inter_cmd_invert_out:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
 
-;;; Wait for a zero bit using the in_wait macro. Adjust for
-;;; INTER_MODE. Zero flag set on error.
-wait_for_zero:
-        btfsc   INTER_MODE, 0
-        goto    wait_for_zero_rpi
+        movlw   1
+        call    read_num
+        movwf   INTER_VALUE
 
-wait_for_zero_man:
-        btfss   INTER_MODE, 1
-        goto    wait_for_zero_man_idle_low
+        call    read_newline
 
-wait_for_zero_man_idle_high:
-        nop                     ; adjust timing
+        btfsc   STATUS, Z
+        goto    inter_error_just_read
 
-        call    wait_for_uart_low ; idle is one
+        movfw   INTER_VALUE
+        call    inter_set_invert_out
 
-        return
+        call    wait_100ms
 
-wait_for_zero_man_idle_low:
-        call    wait_for_uart_high
+        movlw   '\n'
+        call    write_char      ; Try to flush output after change
 
-        return
+        call    wait_100ms
 
-wait_for_zero_rpi:
-        nop                     ; adjust timing
-        nop                     ; adjust timing
+        movlw   '\n'
+        call    write_char      ; Try to flush output after change
 
-        call    wait_for_uart2_low
+        call    wait_100ms
 
-        return
+        movlw   '\n'
+        call    write_char      ; Try to flush output after change
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        call    wait_100ms
 
-;;; Wait for low signal on UART using in_wait macro.
-wait_for_uart_low:
-        in_wait UART_PORT, UART_PIN, 0
-        return
+        movlw   '\n'
+        call    write_char      ; Try to flush output after change
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        goto    interactive
 
-;;; Wait for high signal on UART using in_wait macro.
-wait_for_uart_high:
-        in_wait UART_PORT, UART_PIN, 1
-        return
+;;; //////////
 
-;;; /////////////////////////////////////////////////////////////////////////////
+inter_cmd_suppress:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
 
-;;; Wait for low signal on UART2 using in_wait macro.
-wait_for_uart2_low:
-        in_wait UART2_PORT, UART2_PIN, 0
-        return
+        call    read_channel
+        movwf   INTER_CHANNEL
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        call    read_hex_dbl
+        movwf   INTER_VALUE
 
-;;; Wait for high signal on UART2 using in_wait macro.
-wait_for_uart2_high:
-        in_wait UART2_PORT, UART2_PIN, 1
-        return
+        call    read_newline
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        btfsc   STATUS, Z
+        goto    inter_error_just_read
 
-;;; Manually read a character from an input channel. Carry flag set on
-;;; success.
-read_char_man:
-        bcf     STATUS, C       ; indicate an error in case we return early
+        movlw   HIGH(SUPPRESS0)
+        movwf   FSR1H
+        movfw   INTER_CHANNEL
+        addlw   LOW(SUPPRESS0)
+        movwf   FSR1L
 
-        btfsc   INTER_MODE, 1
-        goto    read_char_man_lp_idle_high
+        movfw   INTER_VALUE
+        movwf   INDF1
 
-read_char_man_lp_idle_low:
-        btfsc   CONFIG_PORT, CONFIG_PIN
-        return                  ; Return error if CONFIG signal high (should not be in interactive mode)
+        goto    interactive
 
-        btfss   UART_PORT, UART_PIN
-        goto    read_char_man_lp_idle_low
+;;; //////////
 
-        goto    read_char_man_ready
+inter_cmd_discard:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
 
-read_char_man_lp_idle_high:
-        btfsc   CONFIG_PORT, CONFIG_PIN
-        return                  ; Return error if CONFIG signal high (should not be in interactive mode)
+        call    read_channel
+        movwf   INTER_CHANNEL
 
-        btfsc   UART_PORT, UART_PIN
-        goto    read_char_man_lp_idle_high
+        call    read_hex_dbl
+        movwf   INTER_VALUE
 
-        nop                     ; to get the same timing as when idle is low
-        nop
+        call    read_newline
 
-read_char_man_ready:
-        call    read_first_bit  ; wait half an input cycle before reading
-        btfsc   STATUS, C
-        goto    read_char_man_err ; first bit should be zero
+        btfsc   STATUS, Z
+        goto    inter_error_just_read
 
-        movlw   0x80
-        movwf   INTER_CHAR
+        movfw   INTER_VALUE
+        btfsc   STATUS, Z
+        goto    discard_ok      ; A value of zero is ok
 
-read_char_man_next:
-        call    read_bit        ; 1667 cycles between calls
-        rrf     INTER_CHAR, f
+        vfcall  convert_char
+        addlw   0               ; Update zero flag
+        btfss   STATUS, Z
+        incf    WREG, W
+        movlw   '\n'            ; Set last char in case of error
+        btfsc   STATUS, Z
+        goto    inter_error_just_read ; Error binary char chosen
 
-        btfss   STATUS, C       ; this is the bit that was put in to start with
-        goto    read_char_man_next
+discard_ok:
+        movlw   HIGH(DISCARD_CHAR0)
+        movwf   FSR1H
+        movfw   INTER_CHANNEL
+        addlw   LOW(DISCARD_CHAR0)
+        movwf   FSR1L
 
-        nop
+        movfw   INTER_VALUE
+        movwf   INDF1
 
-        call    read_bit
+        goto    interactive
 
-        ;; Carry flag is set when the stop bit is a one like it should be
+;;; //////////
 
-        movfw   INTER_CHAR
+inter_cmd_speed:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
 
-        return
+        movlw   4
+        call    read_num
+        movwf   INTER_VALUE
 
-read_char_man_err:
-        clrw
+        call    read_newline
 
-        bcf     STATUS, C       ; clear carry to indicate error
+        btfsc   STATUS, Z
+        goto    inter_error_just_read
 
-        return
+        movfw   INTER_VALUE
+        movlb   12
+        movwf   INTER_SPEED
+        movlb   0
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        goto    interactive
 
-;;; 1662 cycles including call and return. Read a bit and put it in carry flag.
-read_bit:
-        movlw   0xD0
+;;; //////////
 
-read_bit_lp1:
-        nop
-        decfsz  WREG, f
-        goto    read_bit_lp1    ; 4 cycles per iteration
+inter_cmd_schmitt:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
 
-        nop
+        call    read_hex_dbl
+        movwf   INTER_VALUE
 
-read_first_bit:                 ; 833 cycles to here
+        call    read_newline
 
-        movlw   0xCC
+        btfsc   STATUS, Z
+        goto    inter_error_just_read
 
-read_bit_lp2:
-        nop
-        decfsz  WREG, f
-        goto    read_bit_lp2    ; 4 cycles per iteration
+        movfw   INTER_VALUE
+        call    inter_set_schmitt
 
-        ;; 1649 cycles to here
+        goto    interactive
 
-        bsf     STATUS, C       ; idle is one bit
+;;; //////////
 
-        btfss   INTER_MODE, 1
-        goto    read_bit_idle_low
+inter_cmd_output:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
 
-        nop
-        btfss   UART_PORT, UART_PIN ; read at 1655 of 1662 cycles from call
-        bcf     STATUS, C
+        call    read_newline
 
-        goto    vreturn_in_4    ; 1659 cycles to here
+        btfsc   STATUS, Z
+        goto    inter_error_just_read
 
-read_bit_idle_low:
-        btfsc   UART_PORT, UART_PIN ; read at 1655 of 1662 cycles from call
-        bcf     STATUS, C
+        call    inter_output_channel_output
 
-        goto    vreturn_in_4    ; 1659 cycles to here
+        call    inter_output_fast
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        call    inter_output_return_newline
 
-;;; Read a character from the serial port.
-read_char:
-        btfss   INTER_MODE, 0
-        goto    read_char_man   ; Read manually for stand alone board
+        call    inter_output_invert
 
-        movlb   3
+        call    inter_output_invert_out
 
-        btfsc   RC1STA, OERR
-        bcf     RC1STA, CREN    ; Clear CREN on error
-        bsf     RC1STA, CREN
+        movlw   0
+        call    inter_output_suppress
+        movlw   1
+        call    inter_output_suppress
+        movlw   2
+        call    inter_output_suppress
+        movlw   3
+        call    inter_output_suppress
+        movlw   4
+        call    inter_output_suppress
+        movlw   5
+        call    inter_output_suppress
+        movlw   6
+        call    inter_output_suppress
+        movlw   7
+        call    inter_output_suppress
 
-        movlb   0
+        movlw   0
+        call    inter_output_discard
+        movlw   1
+        call    inter_output_discard
+        movlw   2
+        call    inter_output_discard
+        movlw   3
+        call    inter_output_discard
+        movlw   4
+        call    inter_output_discard
+        movlw   5
+        call    inter_output_discard
+        movlw   6
+        call    inter_output_discard
+        movlw   7
+        call    inter_output_discard
 
-read_char_lp:
-        btfsc   CONFIG_PORT, CONFIG_PIN
-        return                  ; Return if CONFIG signal high (should not be in interactive mode)
+        call    inter_output_speed
 
-        btfss   PIR1, RCIF
-        goto    read_char_lp    ; Wait for data
+        call    inter_output_schmitt
 
-        movlb   3
-        movfw   RC1REG
-        movlb   0
+        call    inter_output_osctune
 
-        return
+        call    inter_output_checksum
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        movlw   0
+        call    inter_output_filter
+        movlw   1
+        call    inter_output_filter
+        movlw   2
+        call    inter_output_filter
+        movlw   3
+        call    inter_output_filter
+        movlw   4
+        call    inter_output_filter
+        movlw   5
+        call    inter_output_filter
+        movlw   6
+        call    inter_output_filter
+        movlw   7
+        call    inter_output_filter
 
-;;; Read an input command.
-read_cmd:
-        call    read_char
+        goto    interactive_no_ok
 
-        bsf     STATUS, Z
-        btfsc   CONFIG_PORT, CONFIG_PIN
-        return                  ; Return error if CONFIG signal high (should not be in interactive mode)
+;;; //////////
 
-        movwf   INTER_VALUE
-        sublw   '\n'
-        btfss   STATUS, Z
-        return                  ; Success
-        sublw   '\n'            ; Set W to the originally read char (\n)
-        bsf     STATUS, Z
-        return                  ; Error
+inter_cmd_save:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        call    read_newline
 
-;;; Read a number from 0 to W (included and <= 9), put it in W.
-read_num:
         btfsc   STATUS, Z
-        return
-
-        movwf   INTER_TMP
-        call    read_char
-        addlw   -'0'
-        subwf   INTER_TMP, W
-        btfss   STATUS, C
-        goto    read_num_error
-
-read_num_success:
-        subwf   INTER_TMP, W
-        bcf     STATUS, Z
-        return                  ; Success
-
-read_num_error:
-        subwf   INTER_TMP, W    ; Restore W to read char
-        addlw   '0'
-        bsf     STATUS, Z
-        return                  ; Error
+        goto    inter_error_just_read
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        call    save_user_settings
 
-;;; Read an input character of 1-8 and return 0-7 (i.e. one less).
-read_channel:
-        movlw   8
-        call    read_num
-        btfsc   STATUS, Z
-        return                  ; Error
+        goto    interactive
 
-        addlw   0xFF            ; Subtract one
-        bcf     STATUS, Z
-        btfsc   STATUS, C
-        return                  ; Success
+;;; //////////
 
-        bsf     STATUS, Z       ; We have read '0' which is not a channel
-        movlw   '0'             ; Restore W to read char
-        return                  ; Error
+inter_cmd_load:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        call    read_newline
 
-;;; Read a single hex number and put it in W.
-read_hex_sgl:
         btfsc   STATUS, Z
-        return
-
-        call    read_char
-        addlw   -'A'
-        btfsc   STATUS, C
-        goto    read_hex_A_F
-
-read_hex_0_9:
-        addlw   'A'-'0'
-        sublw   9
-        btfss   STATUS, C
-        goto    read_hex_error_0_9
-        sublw   9
-        bcf     STATUS, Z
-        return
-
-read_hex_error_0_9:
-        sublw   9               ; Restore W to read char
-        addlw   '0'
-        bsf     STATUS, Z
-        return
-
-read_hex_A_F:
-        sublw   5
-        btfss   STATUS, C
-        goto    read_hex_error_A_F
-        sublw   5
-        addlw   0x0A
-        bcf     STATUS, Z
-        return
+        goto    inter_error_just_read
 
-read_hex_error_A_F:
-        sublw   5
-        addlw   'A'
-        bsf     STATUS, Z
-        return
+        call    load_user_settings
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        goto    interactive
 
-;;; Read a double digit hex number and put it in W.
-read_hex_dbl:
-        btfsc   STATUS, Z
-        return
+;;; //////////
 
-        call    read_hex_sgl
-        movwf   INTER_TMP
+inter_cmd_factory:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
 
-        call    read_hex_sgl
+        call    read_newline
 
         btfsc   STATUS, Z
-        return
-
-        swapf   INTER_TMP, f
-        iorwf   INTER_TMP, W
+        goto    inter_error_just_read
 
-        bcf     STATUS, Z
-        return
+        call    load_factory_settings
+        call    save_user_settings
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        goto    interactive
 
-;;; Read a newline (or return followed by newline). Zero flag is set
-;;; on error.
-read_newline:
-        btfsc   STATUS, Z
-        return
+;;; //////////
 
-        call    read_char
-        sublw   '\n'
-        btfss   STATUS, Z
-        goto    read_newline_error
+inter_cmd_debug:
+        bcf     STATUS, Z       ; Indicate that no error has occurred
 
-read_newline_success:
-        bcf     STATUS, Z
-        return
+        call    read_newline
 
-read_newline_error:
-        sublw   '\n'
-        sublw   '\r'
         btfsc   STATUS, Z
-        goto    read_newline_return ; We read a return
+        goto    inter_error_just_read
 
-        sublw   '\r'            ; Restore W to read char
-        bsf     STATUS, Z       ; Return error
-        return
+        call    output_debug
 
-read_newline_return:
-        bcf     STATUS, Z       ; Clear error and try again
-        goto    read_newline
+        goto    interactive_no_ok
 
-;;; /////////////////////////////////////////////////////////////////////////////
+;;; //////////
 
-;;; A number of functions for all the commands-
-inter_cmd_channel_output:
+inter_cmd_calibrate:
         bcf     STATUS, Z       ; Indicate that no error has occurred
 
-        movlw   1
-        call    read_num
-        movwf   INTER_VALUE
-
         call    read_newline
 
         btfsc   STATUS, Z
         goto    inter_error_just_read
 
-        bsf     CHN_OUT_FLAGS, CHN_OUT_BIT
-        btfss   INTER_VALUE, 0
-        bcf     CHN_OUT_FLAGS, CHN_OUT_BIT
+        call    calibrate_clock
 
-        goto    interactive
+        btfsc   STATUS, Z
+        goto    inter_error
+
+        goto    interactive_no_ok
 
 ;;; //////////
 
-inter_cmd_fast:
+inter_cmd_osctune:
         bcf     STATUS, Z       ; Indicate that no error has occurred
 
-        call    read_hex_sgl
+        call    read_hex_dbl
         movwf   INTER_VALUE
 
+        btfsc   INTER_VALUE, 7
+        call    inter_error     ; Value should be of the form 00xxxxxx
+        btfsc   INTER_VALUE, 6
+        call    inter_error     ; Value should be of the form 00xxxxxx
+
         call    read_newline
 
         btfsc   STATUS, Z
         goto    inter_error_just_read
 
-        movfw   FAST_FLAGS
-        andlw   0xF0
-        iorwf   INTER_VALUE, W
-        movwf   FAST_FLAGS
+        movfw   INTER_VALUE
+        call    inter_set_osctune
 
         goto    interactive
 
 ;;; //////////
 
-inter_cmd_return_newline:
+inter_cmd_checksum:
         bcf     STATUS, Z       ; Indicate that no error has occurred
 
-        movlw   1
-        call    read_num
+        call    read_hex_dbl
         movwf   INTER_VALUE
 
         call    read_newline
@@ -3894,84 +4825,152 @@ inter_cmd_return_newline:
         btfsc   STATUS, Z
         goto    inter_error_just_read
 
-        bsf     NEWLINE_FLAGS, NEWLINE_BIT
-        btfss   INTER_VALUE, 0
-        bcf     NEWLINE_FLAGS, NEWLINE_BIT
+        movfw   INTER_VALUE
+        movwf   CHK_DROP
 
         goto    interactive
 
 ;;; //////////
 
-inter_cmd_invert:
+inter_cmd_filter:
         bcf     STATUS, Z       ; Indicate that no error has occurred
 
-        call    read_hex_dbl
+        call    read_channel    ; Slot number is read like a channel number
+        movwf   INTER_CHANNEL
+
+        call    read_filter_action
         movwf   INTER_VALUE
 
+        movlw   HIGH(FLT_ADR0)  ; The address filter is not running, so use its
+        movwf   FSR1H           ; address copy for the pattern while reading
+        movlw   LOW(FLT_ADR0)
+        movwf   FSR1L
+
+        call    read_filter_char
+        movwi   FSR1++
+        call    read_filter_char
+        movwi   FSR1++
+        call    read_filter_char
+        movwi   FSR1++
+        call    read_filter_char
+        movwi   FSR1++
+        call    read_filter_char
+        movwi   FSR1++
+
+        call    read_hex_dbl
+        movwf   INTER_TMP2
+
         call    read_newline
 
         btfsc   STATUS, Z
         goto    inter_error_just_read
 
+        movfw   INTER_CHANNEL
+        call    filter_slot_ptr
+
+        movlb   11
+
+        movfw   FLT_ADR0 + 0
+        movwi   FSR1++
+        movfw   FLT_ADR0 + 1
+        movwi   FSR1++
+        movfw   FLT_ADR0 + 2
+        movwi   FSR1++
+        movfw   FLT_ADR0 + 3
+        movwi   FSR1++
+        movfw   FLT_ADR0 + 4
+        movwi   FSR1++
+
+        movlb   0
+
+        movfw   INTER_TMP2
+        movwi   FSR1++
         movfw   INTER_VALUE
-        call    inter_set_invert
+        movwi   FSR1++
+
+        call    filter_update
 
         goto    interactive
 
 ;;; //////////
 
-inter_cmd_invert_out:
-        bcf     STATUS, Z       ; Indicate that no error has occurred
+inter_done:
+        movlb   3
+        bcf     RC1STA, CREN    ; Disable receive, ok to do even if already off
+        movlb   0
 
-        movlw   1
-        call    read_num
-        movwf   INTER_VALUE
+        call    init2
 
-        call    read_newline
+        call    wait_100ms
+
+        return
+
+;;; /////////////////////////////////////////////////////////////////////////////
+
+;;; A number of functions for printing settings.
+inter_output_channel_output:
+        movlw   'C'
+        call    write_char
+
+        movlw   '1'
+        btfss   CHN_OUT_FLAGS, CHN_OUT_BIT
+        movlw   '0'
+        call    write_char
 
-        btfsc   STATUS, Z
-        goto    inter_error_just_read
+        movlw   '\n'
+        call    write_char
 
-        movfw   INTER_VALUE
-        call    inter_set_invert_out
+        return
 
-        call    wait_100ms
+;;; //////////
 
-        movlw   '\n'
-        call    write_char      ; Try to flush output after change
+inter_output_fast:
+        movlw   'F'
+        call    write_char
 
-        call    wait_100ms
+        movfw   FAST_FLAGS
+        call    nibble_to_hex
+        call    write_char
 
         movlw   '\n'
-        call    write_char      ; Try to flush output after change
+        call    write_char
 
-        call    wait_100ms
+        return
 
-        movlw   '\n'
-        call    write_char      ; Try to flush output after change
+;;; //////////
 
-        call    wait_100ms
+inter_output_return_newline:
+        movlw   'N'
+        call    write_char
+
+        movlw   '1'
+        btfss   NEWLINE_FLAGS, NEWLINE_BIT
+        movlw   '0'
+        call    write_char
 
         movlw   '\n'
-        call    write_char      ; Try to flush output after change
+        call    write_char
 
-        goto    interactive
+        return
 
 ;;; //////////
 
-inter_cmd_suppress:
-        bcf     STATUS, Z       ; Indicate that no error has occurred
+inter_output_invert:
+        movlw   'I'
+        call    write_char
 
-        call    read_channel
-        movwf   INTER_CHANNEL
+        call    inter_get_invert
+        call    write_hex
 
-        call    read_hex_dbl
-        movwf   INTER_VALUE
+        movlw   '\n'
+        call    write_char
 
-        call    read_newline
+        return
 
-        btfsc   STATUS, Z
-        goto    inter_error_just_read
+;;; //////////
+
+inter_output_suppress:
+        movwf   INTER_CHANNEL
 
         movlw   HIGH(SUPPRESS0)
         movwf   FSR1H
@@ -3979,462 +4978,504 @@ inter_cmd_suppress:
         addlw   LOW(SUPPRESS0)
         movwf   FSR1L
 
-        movfw   INTER_VALUE
-        movwf   INDF1
-
-        goto    interactive
-
-;;; //////////
-
-inter_cmd_discard:
-        bcf     STATUS, Z       ; Indicate that no error has occurred
+        movlw   'U'
+        call    write_char
 
-        call    read_channel
-        movwf   INTER_CHANNEL
+        movfw   INTER_CHANNEL
+        addlw   '1'
+        call    write_char
 
-        call    read_hex_dbl
-        movwf   INTER_VALUE
+        movfw   INDF1
+        call    write_hex
 
-        call    read_newline
+        movlw   '\n'
+        call    write_char
 
-        btfsc   STATUS, Z
-        goto    inter_error_just_read
+        return
 
-        movfw   INTER_VALUE
-        btfsc   STATUS, Z
-        goto    discard_ok      ; A value of zero is ok
+;;; //////////
 
-        vfcall  convert_char
-        addlw   0               ; Update zero flag
-        btfss   STATUS, Z
-        incf    WREG, W
-        movlw   '\n'            ; Set last char in case of error
-        btfsc   STATUS, Z
-        goto    inter_error_just_read ; Error binary char chosen
+inter_output_discard:
+        movwf   INTER_CHANNEL
 
-discard_ok:
         movlw   HIGH(DISCARD_CHAR0)
         movwf   FSR1H
         movfw   INTER_CHANNEL
         addlw   LOW(DISCARD_CHAR0)
         movwf   FSR1L
 
-        movfw   INTER_VALUE
-        movwf   INDF1
+        movlw   'D'
+        call    write_char
 
-        goto    interactive
+        movfw   INTER_CHANNEL
+        addlw   '1'
+        call    write_char
 
-;;; //////////
+        movfw   INDF1
+        call    write_hex
 
-inter_cmd_speed:
-        bcf     STATUS, Z       ; Indicate that no error has occurred
+        movlw   '\n'
+        call    write_char
 
-        movlw   2
-        call    read_num
-        movwf   INTER_VALUE
+        return
 
-        call    read_newline
+;;; //////////
 
-        btfsc   STATUS, Z
-        goto    inter_error_just_read
+inter_output_speed:
+        movlw   'B'
+        call    write_char
 
-        movfw   INTER_VALUE
         movlb   12
-        movwf   INTER_SPEED
+        movfw   INTER_SPEED
         movlb   0
+        addlw   '0'
+        call    write_char
 
-        goto    interactive
-
-;;; //////////
+        movlw   '\n'
+        call    write_char
 
-inter_cmd_schmitt:
-        bcf     STATUS, Z       ; Indicate that no error has occurred
+        return
 
-        call    read_hex_dbl
-        movwf   INTER_VALUE
+;;; //////////
 
-        call    read_newline
+inter_output_schmitt:
+        movlw   'H'
+        call    write_char
 
-        btfsc   STATUS, Z
-        goto    inter_error_just_read
+        call    inter_get_schmitt
+        call    write_hex
 
-        movfw   INTER_VALUE
-        call    inter_set_schmitt
+        movlw   '\n'
+        call    write_char
 
-        goto    interactive
+        return
 
 ;;; //////////
 
-inter_cmd_output:
-        bcf     STATUS, Z       ; Indicate that no error has occurred
+inter_output_invert_out:
+        movlw   'J'
+        call    write_char
 
-        call    read_newline
+        call    inter_get_invert_out
+        addlw   '0'
+        call    write_char
 
-        btfsc   STATUS, Z
-        goto    inter_error_just_read
+        movlw   '\n'
+        call    write_char
 
-        call    inter_output_channel_output
+        return
 
-        call    inter_output_fast
+;;; //////////
 
-        call    inter_output_return_newline
+inter_output_osctune:
+        movlw   'T'
+        call    write_char
 
-        call    inter_output_invert
+        call    inter_get_osctune
+        call    write_hex
 
-        call    inter_output_invert_out
+        movlw   '\n'
+        call    write_char
 
-        movlw   0
-        call    inter_output_suppress
-        movlw   1
-        call    inter_output_suppress
-        movlw   2
-        call    inter_output_suppress
-        movlw   3
-        call    inter_output_suppress
-        movlw   4
-        call    inter_output_suppress
-        movlw   5
-        call    inter_output_suppress
-        movlw   6
-        call    inter_output_suppress
-        movlw   7
-        call    inter_output_suppress
+        return
 
-        movlw   0
-        call    inter_output_discard
-        movlw   1
-        call    inter_output_discard
-        movlw   2
-        call    inter_output_discard
-        movlw   3
-        call    inter_output_discard
-        movlw   4
-        call    inter_output_discard
-        movlw   5
-        call    inter_output_discard
-        movlw   6
-        call    inter_output_discard
-        movlw   7
-        call    inter_output_discard
+;;; //////////
 
-        call    inter_output_speed
+inter_output_checksum:
+        movlw   'K'
+        call    write_char
 
-        call    inter_output_schmitt
+        movfw   CHK_DROP
+        call    write_hex
 
-        call    inter_output_osctune
+        movlw   '\n'
+        call    write_char
 
-        goto    interactive_no_ok
+        return
 
 ;;; //////////
 
-inter_cmd_save:
-        bcf     STATUS, Z       ; Indicate that no error has occurred
+inter_output_filter:
+        movwf   INTER_CHANNEL
+        call    filter_slot_ptr
 
-        call    read_newline
+        movlw   'A'
+        call    write_char
 
-        btfsc   STATUS, Z
-        goto    inter_error_just_read
+        movfw   INTER_CHANNEL
+        addlw   '1'
+        call    write_char
 
-        call    save_user_settings
+        moviw   6[FSR1]
+        movwf   INTER_TMP
+        movlw   'D'
+        btfsc   INTER_TMP, 0
+        movlw   'A'
+        call    write_char
 
-        goto    interactive
+        moviw   FSR1++
+        call    inter_output_filter_char
+        moviw   FSR1++
+        call    inter_output_filter_char
+        moviw   FSR1++
+        call    inter_output_filter_char
+        moviw   FSR1++
+        call    inter_output_filter_char
+        moviw   FSR1++
+        call    inter_output_filter_char
 
-;;; //////////
+        moviw   FSR1++
+        call    write_hex
 
-inter_cmd_load:
-        bcf     STATUS, Z       ; Indicate that no error has occurred
+        movlw   '\n'
+        call    write_char
 
-        call    read_newline
+        return
 
+inter_output_filter_char:
+        andlw   0x7F
         btfsc   STATUS, Z
-        goto    inter_error_just_read
-
-        call    load_user_settings
+        movlw   '?'
+        call    write_char
 
-        goto    interactive
+        return
 
-;;; //////////
+;;; /////////////////////////////////////////////////////////////////////////////
 
-inter_cmd_factory:
-        bcf     STATUS, Z       ; Indicate that no error has occurred
+;;; Print debug information.
+output_debug:
+        movlw   'V'
+        call    write_char
 
-        call    read_newline
+        movlw   'E'
+        call    write_char
 
-        btfsc   STATUS, Z
-        goto    inter_error_just_read
+        movlw   ' '
+        call    write_char
 
-        call    load_factory_settings
-        call    save_user_settings
+        movlw   MAJOR_VERSION
+        call    write_char
 
-        goto    interactive
+        movlw   '.'
+        call    write_char
 
-;;; //////////
+        movlw   MINOR_VERSION
+        call    write_char
 
-inter_cmd_debug:
-        bcf     STATUS, Z       ; Indicate that no error has occurred
+        movlw   '\n'
+        call    write_char
 
-        call    read_newline
+        movlw   'R'
+        call    write_char
 
-        btfsc   STATUS, Z
-        goto    inter_error_just_read
+        movlw   'I'
+        call    write_char
 
-        call    output_debug
+        movlw   ' '
+        call    write_char
 
-        goto    interactive_no_ok
+        movlb   3               ; Get ready to read revision id
 
-;;; //////////
+        movlw   0x05
+        movwf   PMADRL
+        clrf    PMADRH
 
-inter_cmd_calibrate:
-        bcf     STATUS, Z       ; Indicate that no error has occurred
+        bsf     PMCON1, CFGS    ; Configuration memory
+        bsf     PMCON1, RD      ; Start read
+        nop                     ; Wait
+        nop
+        movfw   PMDATH          ; High part
 
-        call    read_newline
+        movlb   0
 
-        btfsc   STATUS, Z
-        goto    inter_error_just_read
+        call    write_hex
 
-        call    calibrate_clock
+        movlb   3
+        movfw   PMDATL          ; Low part
+        movlb   0
 
-        btfsc   STATUS, Z
-        goto    inter_error
+        call    write_hex
 
-        goto    interactive_no_ok
+        movlw   '\n'
+        call    write_char
 
-;;; //////////
+        movlw   'T'
+        call    write_char
 
-inter_cmd_osctune:
-        bcf     STATUS, Z       ; Indicate that no error has occurred
+        movlw   '1'
+        call    write_char
 
-        call    read_hex_dbl
-        movwf   INTER_VALUE
+        movlw   ' '
+        call    write_char
 
-        btfsc   INTER_VALUE, 7
-        call    inter_error     ; Value should be of the form 00xxxxxx
-        btfsc   INTER_VALUE, 6
-        call    inter_error     ; Value should be of the form 00xxxxxx
+        clrf    TM3L            ; TM1H:L is the negative of the time
+        clrf    TM3H
+        movfw   TM1L
+        subwf   TM3L, f
+        movfw   TM1H
+        subwfb  TM3H, f         ; TM3H:L = -TM1H:L
 
-        call    read_newline
+        movfw   TM3H
+        call    write_hex
 
-        btfsc   STATUS, Z
-        goto    inter_error_just_read
+        movfw   TM3L
+        call    write_hex
 
-        movfw   INTER_VALUE
-        call    inter_set_osctune
+        movlw   '\n'
+        call    write_char
 
-        goto    interactive
+        movlw   'T'
+        call    write_char
 
-;;; //////////
+        movlw   '2'
+        call    write_char
 
-inter_done:
-        movlb   3
-        bcf     RC1STA, CREN    ; Disable receive, ok to do even if already off
-        movlb   0
+        movlw   ' '
+        call    write_char
 
-        call    init2
+        clrf    TM3L            ; TM2H:L is the negative of the time
+        clrf    TM3H
+        movfw   TM2L
+        subwf   TM3L, f
+        movfw   TM2H
+        subwfb  TM3H, f         ; TM3H:L = -TM2H:L
 
-        call    wait_100ms
+        movfw   TM3H
+        call    write_hex
 
-        return
+        movfw   TM3L
+        call    write_hex
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        movlw   '\n'
+        call    write_char
 
-;;; A number of functions for printing settings.
-inter_output_channel_output:
-        movlw   'C'
+        movlw   'M'
         call    write_char
 
-        movlw   '1'
-        btfss   CHN_OUT_FLAGS, CHN_OUT_BIT
-        movlw   '0'
+        movlw   'D'
         call    write_char
 
-        movlw   '\n'
+        movlw   ' '
         call    write_char
 
-        return
+        call    is_raspberry
 
-;;; //////////
+        movlw   'S'             ; Stand alone
+        btfsc   STATUS, C
+        movlw   'R'             ; Raspberry Pi
 
-inter_output_fast:
-        movlw   'F'
         call    write_char
 
-        movfw   FAST_FLAGS
-        call    nibble_to_hex
+        movlw   '\n'
         call    write_char
 
-        movlw   '\n'
+        movlw   'S'
         call    write_char
 
-        return
+        movlw   'E'
+        call    write_char
 
-;;; //////////
+        movlw   ' '
+        call    write_char
 
-inter_output_return_newline:
-        movlw   'N'
+        movlb   12
+        movfw   SEND_CNT
+        movlb   0
+        call    write_hex
+
+        movlb   12
+        movfw   SEND_CNT + 1
+        movlb   0
+        call    write_hex
+
+        movlb   12
+        movfw   SEND_CNT + 2
+        movlb   0
+        call    write_hex
+
+        movlb   12
+        movfw   SEND_CNT + 3
+        movlb   0
+        call    write_hex
+
+        movlw   '\n'
         call    write_char
 
-        movlw   '1'
-        btfss   NEWLINE_FLAGS, NEWLINE_BIT
-        movlw   '0'
+        movlw   'F'
         call    write_char
 
-        movlw   '\n'
+        movlw   'E'
         call    write_char
 
-        return
+        movlw   ' '
+        call    write_char
 
-;;; //////////
+        movfw   CNT_FRAME
+        call    write_hex
 
-inter_output_invert:
-        movlw   'I'
+        movlw   ' '
         call    write_char
 
-        call    inter_get_invert
+        movlw   '('
+        call    write_char
+
+        movfw   ERR_CHN_FRAME
         call    write_hex
 
+        movlw   ')'
+        call    write_char
+
         movlw   '\n'
         call    write_char
 
-        return
+        movlw   'C'
+        call    write_char
 
-;;; //////////
+        movlw   'G'
+        call    write_char
 
-inter_output_suppress:
-        movwf   INTER_CHANNEL
+        movlw   ' '
+        call    write_char
 
-        movlw   HIGH(SUPPRESS0)
-        movwf   FSR1H
-        movfw   INTER_CHANNEL
-        addlw   LOW(SUPPRESS0)
-        movwf   FSR1L
+        movfw   CNT_CONGEST
+        call    write_hex
 
-        movlw   'U'
+        movlw   ' '
         call    write_char
 
-        movfw   INTER_CHANNEL
-        addlw   '1'
+        movlw   '('
         call    write_char
 
-        movfw   INDF1
+        movfw   ERR_CHN_CONGEST
         call    write_hex
 
+        movlw   ')'
+        call    write_char
+
         movlw   '\n'
         call    write_char
 
-        return
+        movlw   'L'
+        call    write_char
 
-;;; //////////
+        movlw   'O'
+        call    write_char
 
-inter_output_discard:
-        movwf   INTER_CHANNEL
+        movlw   ' '
+        call    write_char
 
-        movlw   HIGH(DISCARD_CHAR0)
-        movwf   FSR1H
-        movfw   INTER_CHANNEL
-        addlw   LOW(DISCARD_CHAR0)
-        movwf   FSR1L
+        movlb   12
+        movfw   CNT_LONG
+        movlb   0
+        call    write_hex
 
-        movlw   'D'
+        movlw   ' '
         call    write_char
 
-        movfw   INTER_CHANNEL
-        addlw   '1'
+        movlw   '('
         call    write_char
 
-        movfw   INDF1
+        movlb   12
+        movfw   ERR_CHN_LONG
+        movlb   0
         call    write_hex
 
+        movlw   ')'
+        call    write_char
+
         movlw   '\n'
         call    write_char
 
-        return
+        movlw   'S'
+        call    write_char
 
-;;; //////////
+        movlw   'T'
+        call    write_char
 
-inter_output_speed:
-        movlw   'B'
+        movlw   ' '
         call    write_char
 
         movlb   12
-        movfw   INTER_SPEED
+        movfw   CNT_STUCK
         movlb   0
-        addlw   '0'
-        call    write_char
+        call    write_hex
 
-        movlw   '\n'
+        movlw   ' '
         call    write_char
 
-        return
-
-;;; //////////
-
-inter_output_schmitt:
-        movlw   'H'
+        movlw   '('
         call    write_char
 
-        call    inter_get_schmitt
+        movlb   12
+        movfw   ERR_CHN_STUCK
+        movlb   0
         call    write_hex
 
-        movlw   '\n'
+        movlw   ')'
         call    write_char
 
-        return
-
-;;; //////////
+        movlw   '\n'
+        call    write_char
 
-inter_output_invert_out:
-        movlw   'J'
+        movlw   'B'
         call    write_char
 
-        call    inter_get_invert_out
-        addlw   '0'
+        movlw   'I'
         call    write_char
 
-        movlw   '\n'
+        movlw   ' '
         call    write_char
 
-        return
+        movfw   CNT_BINARY
+        call    write_hex
 
-;;; //////////
+        movlw   ' '
+        call    write_char
 
-inter_output_osctune:
-        movlw   'T'
+        movlw   '('
         call    write_char
 
-        call    inter_get_osctune
+        movfw   ERR_CHN_BINARY
         call    write_hex
 
-        movlw   '\n'
+        movlw   ')'
         call    write_char
 
-        return
-
-;;; /////////////////////////////////////////////////////////////////////////////
+        movlw   '\n'
+        call    write_char
 
-;;; Print debug information.
-output_debug:
-        movlw   'V'
+        movlw   'C'
         call    write_char
 
-        movlw   'E'
+        movlw   'S'
         call    write_char
 
         movlw   ' '
         call    write_char
 
-        movlw   MAJOR_VERSION
+        movlb   11
+        movfw   CNT_CHECKSUM
+        movlb   0
+        call    write_hex
+
+        movlw   ' '
         call    write_char
 
-        movlw   '.'
+        movlw   '('
         call    write_char
 
-        movlw   MINOR_VERSION
+        movlb   11
+        movfw   ERR_CHN_CHECKSUM
+        movlb   0
+        call    write_hex
+
+        movlw   ')'
         call    write_char
 
         movlw   '\n'
         call    write_char
 
-        movlw   'R'
+        movlw   'F'
         call    write_char
 
         movlw   'I'
@@ -4443,744 +5484,835 @@ output_debug:
         movlw   ' '
         call    write_char
 
-        movlb   3               ; Get ready to read revision id
+        movlb   11
+        movfw   CNT_FILTER
+        movlb   0
+        call    write_hex
 
-        movlw   0x05
-        movwf   PMADRL
-        clrf    PMADRH
+        movlw   ' '
+        call    write_char
 
-        bsf     PMCON1, CFGS    ; Configuration memory
-        bsf     PMCON1, RD      ; Start read
-        nop                     ; Wait
-        nop
-        movfw   PMDATH          ; High part
+        movlw   '('
+        call    write_char
 
+        movlb   11
+        movfw   ERR_CHN_FILTER
         movlb   0
-
         call    write_hex
 
-        movlb   3
-        movfw   PMDATL          ; Low part
-        movlb   0
-
-        call    write_hex
+        movlw   ')'
+        call    write_char
 
         movlw   '\n'
         call    write_char
 
-        movlw   'T'
-        call    write_char
+        return
 
-        movlw   '1'
-        call    write_char
+;;; This is extra debug info that is not generally needed:
 
-        movlw   ' '
-        call    write_char
+;;;     movlw   'F'
+;;;     call    write_char
 
-        clrf    TM3L            ; TM1H:L is the negative of the time
-        clrf    TM3H
-        movfw   TM1L
-        subwf   TM3L, f
-        movfw   TM1H
-        subwfb  TM3H, f         ; TM3H:L = -TM1H:L
+;;;     movlw   'B'
+;;;     call    write_char
 
-        movfw   TM3H
-        call    write_hex
+;;;     movlw   ' '
+;;;     call    write_char
 
-        movfw   TM3L
-        call    write_hex
+;;;     movfw   BK_FREEH
+;;;     call    write_hex
 
-        movlw   '\n'
-        call    write_char
+;;;     movfw   BK_FREEL
+;;;     call    write_hex
 
-        movlw   'T'
-        call    write_char
+;;;     movlw   '\n'
+;;;     call    write_char
 
-        movlw   '2'
-        call    write_char
+;;;     movlw   LOW(REF0) + 11
+;;;     movwf   FSR1L
+;;;     movlw   HIGH(REF0)
+;;;     movwf   FSR1H
 
-        movlw   ' '
-        call    write_char
+;;;     moviw   FSR1--
+;;;     call    write_hex
 
-        clrf    TM3L            ; TM2H:L is the negative of the time
-        clrf    TM3H
-        movfw   TM2L
-        subwf   TM3L, f
-        movfw   TM2H
-        subwfb  TM3H, f         ; TM3H:L = -TM2H:L
+;;;     moviw   FSR1--
+;;;     call    write_hex
 
-        movfw   TM3H
-        call    write_hex
+;;;     moviw   FSR1--
+;;;     call    write_hex
 
-        movfw   TM3L
-        call    write_hex
+;;;     moviw   FSR1--
+;;;     call    write_hex
 
-        movlw   '\n'
-        call    write_char
+;;;     moviw   FSR1--
+;;;     call    write_hex
 
-        movlw   'M'
-        call    write_char
+;;;     moviw   FSR1--
+;;;     call    write_hex
 
-        movlw   'D'
-        call    write_char
+;;;     moviw   FSR1--
+;;;     call    write_hex
 
-        movlw   ' '
-        call    write_char
+;;;     moviw   FSR1--
+;;;     call    write_hex
 
-        call    is_raspberry
+;;;     moviw   FSR1--
+;;;     call    write_hex
 
-        movlw   'S'             ; Stand alone
-        btfsc   STATUS, C
-        movlw   'R'             ; Raspberry Pi
+;;;     moviw   FSR1--
+;;;     call    write_hex
 
-        call    write_char
+;;;     moviw   FSR1--
+;;;     call    write_hex
 
-        movlw   '\n'
-        call    write_char
+;;;     movlw   '\n'
+;;;     call    write_char
 
-        movlw   'S'
-        call    write_char
+;;;     movlw   LOW(BANK0) + 7
+;;;     movwf   FSR1L
+;;;     movlw   HIGH(BANK0)
+;;;     movwf   FSR1H
 
-        movlw   'E'
-        call    write_char
+;;;     moviw   FSR1--
+;;;     call    write_hex
 
-        movlw   ' '
-        call    write_char
+;;;     moviw   FSR1--
+;;;     call    write_hex
+
+;;;     moviw   FSR1--
+;;;     call    write_hex
+
+;;;     moviw   FSR1--
+;;;     call    write_hex
+
+;;;     moviw   FSR1--
+;;;     call    write_hex
+
+;;;     moviw   FSR1--
+;;;     call    write_hex
+
+;;;     moviw   FSR1--
+;;;     call    write_hex
+
+;;;     moviw   FSR1--
+;;;     call    write_hex
+
+;;;     movlw   '\n'
+;;;     call    write_char
+
+;;;     return
+
+;;; /////////////////////////////////////////////////////////////////////////////
+
+;;; Set carry flag according to whether the board is run from a
+;;; Raspberry Pi (supply voltage <= 4.096 V, typically 3.3) or stand
+;;; alone (> 4.096 V, typically 5.0).
+is_raspberry:
+        movlb   1
+        rlf     ADRESH, W       ; Carry flag set to highest A/D bit
+        movlb   0
+
+        return
+
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        movlb   12
-        movfw   SEND_CNT
-        movlb   0
-        call    write_hex
+;;; Set up the PIC.
+init:
+        movlb   1
 
-        movlb   12
-        movfw   SEND_CNT + 1
-        movlb   0
-        call    write_hex
+        bsf     OSCCON, IRCF3
+        bcf     OSCCON, IRCF0   ; 32 MHz
 
-        movlb   12
-        movfw   SEND_CNT + 2
-        movlb   0
-        call    write_hex
+        bcf     TRISC, TRISC0   ; RC0 as output
 
-        movlb   12
-        movfw   SEND_CNT + 3
-        movlb   0
-        call    write_hex
+        bcf     OPTION_REG, NOT_WPUEN ; Enable weak pull-up
 
-        movlw   '\n'
-        call    write_char
+        movlb   3
 
-        movlw   'F'
-        call    write_char
+        clrf    ANSELA          ; All PORTA pins as digital
+        clrf    ANSELC          ; All PORTC pins as digital
 
-        movlw   'E'
-        call    write_char
+        bsf     TX1STA, BRGH    ; High baud rate
+        bsf     BAUD1CON, BRG16 ; 16 bit baud rate
 
-        movlw   ' '
-        call    write_char
+        bsf     RC1STA, SPEN    ; Enable serial port
 
-        movfw   CNT_FRAME
-        call    write_hex
+        bsf     TX1STA, TXEN    ; Enable transmission
+        bcf     TX1STA, SYNC    ; Asynchronous
 
-        movlw   ' '
-        call    write_char
+        movlb   8
 
-        movlw   '('
-        call    write_char
+        movlw   0xF6
+        movwf   PR4             ; Period for timer 4, used for channel busy timer
 
-        movfw   ERR_CHN_FRAME
-        call    write_hex
+        movlw   0x27
+        movwf   T4CON           ; on, postscaler 5, prescaler 64 for about 9.84 ms = 2.5 s / 256
 
-        movlw   ')'
-        call    write_char
+        movlb   28
 
-        movlw   '\n'
-        call    write_char
+#ifdef VER_01_PCB
+        movlw   0x15
+        movwf   RXPPS           ; RC5 is UART receive (for Raspberry Pi mode)
+#else
+        movlw   0x11
+        movwf   RXPPS           ; RC1 is UART receive (for Raspberry Pi mode)
+#endif
 
-        movlw   'C'
-        call    write_char
+        movlb   29
 
-        movlw   'G'
-        call    write_char
+        movlw   0x14
+        movwf   RC0PPS          ; RC0 as UART transmit
 
-        movlw   ' '
-        call    write_char
+        movlb   0
 
-        movfw   CNT_CONGEST
-        call    write_hex
+        bsf     T1CON, TMR1ON
 
-        movlw   ' '
-        call    write_char
+        movlw   0x82
+        movwf   PR2             ; Period for timer 2, used for breaks after sending newline
 
-        movlw   '('
-        call    write_char
+        return
 
-        movfw   ERR_CHN_CONGEST
-        call    write_hex
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        movlw   ')'
-        call    write_char
+;;; Set up the variables along with the baud rate. This is called both
+;;; at startup and after the interactive mode.
+init2:
+        clrf    SEND_CNT_TMP
 
-        movlw   '\n'
-        call    write_char
+        movlb   11
 
-        movlw   'L'
-        call    write_char
+        clrf    TIMER0H + FAST0_NUM
+        clrf    TIMER0H + FAST1_NUM
+        clrf    TIMER0H + FAST2_NUM
+        clrf    TIMER0H + FAST3_NUM
+        clrf    TIMER0H + SLOW0_NUM
+        clrf    TIMER0H + SLOW1_NUM
+        clrf    TIMER0H + SLOW2_NUM
+        clrf    TIMER0H + SLOW3_NUM
 
-        movlw   'O'
-        call    write_char
+        clrf    CNT_CHECKSUM
+        clrf    ERR_CHN_CHECKSUM
 
-        movlw   ' '
-        call    write_char
+        clrf    CNT_FILTER
+        clrf    ERR_CHN_FILTER
+
+        movlw   0x07
+        movwf   FLT_CH
+        movlw   0x80
+        movwf   FLT_CHBIT       ; Last channel, so the first channel is checked first
 
-        movlb   12
-        movfw   CNT_LONG
         movlb   0
-        call    write_hex
 
-        movlw   ' '
-        call    write_char
+        clrf    FLT_STATE
 
-        movlw   '('
-        call    write_char
+        clrf    CH_RDY
+        movlw   0xFF
+        movwf   WAITING
+        movwf   PHASE           ; Mark every channel as having a framing error,
+                                ; this will make sure the first sentence is right
+        clrf    DONE
 
-        movlb   12
-        movfw   ERR_CHN_LONG
-        movlb   0
-        call    write_hex
+        clrf    CH_BUSY
 
-        movlw   ')'
-        call    write_char
+        clrf    READF0
+        clrf    READF1
+        clrf    READF2
+        clrf    READF3
+        clrf    READS0
+        clrf    READS1
+        clrf    READS2
+        clrf    READS3
 
-        movlw   '\n'
-        call    write_char
+        movlw   0x80
+        movwf   SEND_BK
 
-        movlw   'S'
-        call    write_char
+        clrf    Q_START
+        clrf    Q_END
 
-        movlw   'T'
-        call    write_char
+        movlw   BANK_MASKL      ; Mark free banks as such
+        movwf   BK_FREEL
+        movlw   BANK_MASKH
+        movwf   BK_FREEH
 
-        movlw   ' '
-        call    write_char
+        movlw   6
+        movwf   FSR0H           ; Reset FSR0H to point to bank 12
 
         movlb   12
-        movfw   CNT_STUCK
-        movlb   0
-        call    write_hex
 
-        movlw   ' '
-        call    write_char
+        clrf    SEND_CNT
+        clrf    SEND_CNT + 1
+        clrf    SEND_CNT + 2
+        clrf    SEND_CNT + 3
 
-        movlw   '('
-        call    write_char
+        clrf    CNT_LONG
+        clrf    ERR_CHN_LONG
+        clrf    CNT_STUCK
+        clrf    ERR_CHN_STUCK
 
-        movlb   12
-        movfw   ERR_CHN_STUCK
         movlb   0
-        call    write_hex
 
-        movlw   ')'
-        call    write_char
+        clrf    ACTIVE
 
-        movlw   '\n'
-        call    write_char
+        clrf    STUCK_MODE2
+        movlw   0x08
+        movwf   STUCK_MODE1     ; start at 0x0008
 
-        movlw   'B'
-        call    write_char
+        clrf    CNT_CONGEST
+        clrf    ERR_CHN_CONGEST
+        clrf    CNT_FRAME
+        clrf    ERR_CHN_FRAME
+        clrf    CNT_BINARY
+        clrf    ERR_CHN_BINARY
 
-        movlw   'I'
-        call    write_char
+        clrf    TM1H
+        clrf    TM1L
 
-        movlw   ' '
-        call    write_char
+        movlw   0xFF
+        movwf   TM2H
+        movwf   TM2L
 
-        movfw   CNT_BINARY
-        call    write_hex
+        bcf     TM_VALID_FLAGS, TM_VALID_BIT
+        bcf     SD_CH_FLAGS, SD_CH_BIT ; No char to send
 
-        movlw   ' '
-        call    write_char
+        movlw   0xFF
+        movwf   BANK0 + 0
+        movwf   BANK0 + 1
+        movwf   BANK0 + 2
+        movwf   BANK0 + 3
+        movwf   BANK0 + 4
+        movwf   BANK0 + 5
+        movwf   BANK0 + 6
+        movwf   BANK0 + 7
 
-        movlw   '('
-        call    write_char
+        movlb   12
 
-        movfw   ERR_CHN_BINARY
-        call    write_hex
+        movwf   REF0 + 1
+        movwf   REF0 + 2
+        movwf   REF0 + 3
+        movwf   REF0 + 4
+        movwf   REF0 + 5
+        movwf   REF0 + 6
+        movwf   REF0 + 7
+        movwf   REF0 + 8
+        movwf   REF0 + 9
+        movwf   REF0 + 10
+        movwf   REF0 + 11
 
-        movlw   ')'
-        call    write_char
+        movlb   3
 
-        movlw   '\n'
-        call    write_char
+        btfss   TX1STA, TRMT    ; Wait for trasmission to finish
+        goto    $-1             ; before setting speed
 
-        return
+        movlb   12
 
-;;; This is extra debug info that is not generally needed:
+        movfw   INTER_SPEED
 
-;;;     movlw   'F'
-;;;     call    write_char
+        movlb   0
 
-;;;     movlw   'B'
-;;;     call    write_char
+        call    speed_set
 
-;;;     movlw   ' '
-;;;     call    write_char
+        movlb   2
 
-;;;     movfw   BK_FREEH
-;;;     call    write_hex
+        movlw   0x82
+        movwf   FVRCON          ; Enable fixed voltage reference, set to 2.048 V for A/D conversion
+
+        btfss   FVRCON, FVRRDY
+        goto    $-1             ; Wait for voltage reference to be ready
 
-;;;     movfw   BK_FREEL
-;;;     call    write_hex
+        movlb   1
 
-;;;     movlw   '\n'
-;;;     call    write_char
+        movlw   0x7D
+        movwf   ADCON0          ; A/D conversion on and set to fixed voltage reference
 
-;;;     movlw   LOW(REF0) + 11
-;;;     movwf   FSR1L
-;;;     movlw   HIGH(REF0)
-;;;     movwf   FSR1H
+        movlw   0x60
+        movwf   ADCON1          ; A/D conversion result left justified, clock Fosc/64, Vss and Vdd refs
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+        movlb   0
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+        return
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+;;; /////////////////////////////////////////////////////////////////////////////
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+init3:
+        movlb   1
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+        bsf     ADCON0, GO_NOT_DONE
+        btfsc   ADCON0, GO_NOT_DONE
+        goto    $-1             ; Wait for A/D conversion to be done
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+        movlw   0x00
+        movwf   ADCON0          ; Disable A/D conversion
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+        movlb   2
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+        movlw   0x00
+        movwf   FVRCON          ; Disable fixed voltage reference
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+        movlb   0
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+        return
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+;;; /////////////////////////////////////////////////////////////////////////////
 
-;;;     movlw   '\n'
-;;;     call    write_char
+;;; Wait a little
+wait_100ms:
+        movlw   0x04            ; Take a break of about 100 ms (clock is 32 MHz)
+        movwf   CHAR0
+        clrf    CHAR0 + 1
+        clrf    CHAR0 + 2
+wait_100ms_lp:
+        decfsz  CHAR0 + 2, f
+        goto    wait_100ms_lp
+        decfsz  CHAR0 + 1, f
+        goto    wait_100ms_lp
+        decfsz  CHAR0, f
+        goto    wait_100ms_lp
 
-;;;     movlw   LOW(BANK0) + 7
-;;;     movwf   FSR1L
-;;;     movlw   HIGH(BANK0)
-;;;     movwf   FSR1H
+        return
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+;;; /////////////////////////////////////////////////////////////////////////////
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+;;; Set serial speed according to W (0-4).
+speed_set:
+        brw
+        goto    speed_4800
+        goto    speed_38400
+        goto    speed_115200
+        goto    speed_230400
+        goto    speed_460800
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+;;; /////////////////////////////////////////////////////////////////////////////
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+;;; Set serial speed to 4,800 baud.
+speed_4800:
+        movlb   3
+        movlw   6
+        movwf   SP1BRGH
+        movlw   130
+        movwf   SP1BRGL         ; 4,799 baud
+        movlb   0
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+        movlw   0x2B
+        movwf   T2CON           ; off, postscaler 6, prescaler 64 for 6240 us or 30 bits
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+        return
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+;;; /////////////////////////////////////////////////////////////////////////////
 
-;;;     moviw   FSR1--
-;;;     call    write_hex
+;;; Set serial speed to 38,400 baud.
+speed_38400:
+        movlb   3
+        clrf    SP1BRGH
+        movlw   207
+        movwf   SP1BRGL         ; 38,462 baud
+        movlb   0
 
-;;;     movlw   '\n'
-;;;     call    write_char
+        movlw   0x12
+        movwf   T2CON           ; off, postscaler 3, prescaler 16 for 780 us or 30 bits
 
-;;;     return
+        return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Set carry flag according to whether the board is run from a
-;;; Raspberry Pi (supply voltage <= 4.096 V, typically 3.3) or stand
-;;; alone (> 4.096 V, typically 5.0).
-is_raspberry:
-        movlb   1
-        rlf     ADRESH, W       ; Carry flag set to highest A/D bit
+;;; Set serial speed to 115,200 baud.
+speed_115200:
+        movlb   3
+        clrf    SP1BRGH
+        movlw   68
+        movwf   SP1BRGL         ; 115,942 baud
         movlb   0
 
+        movlw   0x02
+        movwf   T2CON           ; off, postscaler 1, prescaler 16 for 260 us or 30 bits
+
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; Set up the PIC.
-init:
-        movlb   1
+;;; Set serial speed to 230,400 baud.
+speed_230400:
+        movlb   3
+        clrf    SP1BRGH
+        movlw   34
+        movwf   SP1BRGL         ; 228,571 baud
+        movlb   0
 
-        bsf     OSCCON, IRCF3
-        bcf     OSCCON, IRCF0   ; 32 MHz
+        movlw   0x09
+        movwf   T2CON           ; off, postscaler 2, prescaler 4 for 130 us or 30 bits
 
-        bcf     TRISC, TRISC0   ; RC0 as output
+        return
 
-        bcf     OPTION_REG, NOT_WPUEN ; Enable weak pull-up
+;;; /////////////////////////////////////////////////////////////////////////////
 
+;;; Set serial speed to 460,800 baud.
+speed_460800:
         movlb   3
+        clrf    SP1BRGH
+        movlw   16
+        movwf   SP1BRGL         ; 470,588 baud
+        movlb   0
 
-        clrf    ANSELA          ; All PORTA pins as digital
-        clrf    ANSELC          ; All PORTC pins as digital
+        movlw   0x01
+        movwf   T2CON           ; off, postscaler 1, prescaler 4 for 65 us or 30 bits
 
-        bsf     TX1STA, BRGH    ; High baud rate
-        bsf     BAUD1CON, BRG16 ; 16 bit baud rate
+        return
 
-        bsf     RC1STA, SPEN    ; Enable serial port
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        bsf     TX1STA, TXEN    ; Enable transmission
-        bcf     TX1STA, SYNC    ; Asynchronous
+;;; A goto to one of these is a delayed return here in the veryfar section.
+vreturn_in_4:
+        nop
+vreturn_in_3:
+        return
 
-        movlb   8
+;;; /////////////////////////////////////////////////////////////////////////////
+;;; Remote section starts here.
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        movlw   0xF6
-        movwf   PR4             ; Period for timer 4, used for channel busy timer
+remote  code    0x1800
 
-        movlw   0x27
-        movwf   T4CON           ; on, postscaler 5, prescaler 64 for about 9.84 ms = 2.5 s / 256
+;;; 46 cycles including nrcall and return. Finishes storage or sends
+;;; data.
+store_s0b:
+        mv_char2 SLOW0_NUM
 
-        movlb   28
+;;; //////////
 
-#ifdef VER_01_PCB
-        movlw   0x15
-        movwf   RXPPS           ; RC5 is UART receive (for Raspberry Pi mode)
-#else
-        movlw   0x11
-        movwf   RXPPS           ; RC1 is UART receive (for Raspberry Pi mode)
-#endif
+store_s1b:
+        mv_char2 SLOW1_NUM
 
-        movlb   29
+;;; //////////
 
-        movlw   0x14
-        movwf   RC0PPS          ; RC0 as UART transmit
+store_s2b:
+        mv_char2 SLOW2_NUM
 
-        movlb   0
+;;; //////////
 
-        bsf     T1CON, TMR1ON
+store_s3b:
+        mv_char2 SLOW3_NUM
 
-        movlw   0x82
-        movwf   PR2             ; Period for timer 2, used for breaks after sending newline
+;;; //////////
 
-        return
+store_f0b:
+        mv_char2 FAST0_NUM
 
-;;; /////////////////////////////////////////////////////////////////////////////
+;;; //////////
 
-;;; Set up the variables along with the baud rate. This is called both
-;;; at startup and after the interactive mode.
-init2:
-        clrf    SEND_CNT_TMP
+store_f1b:
+        mv_char2 FAST1_NUM
 
-        clrf    TIMER0H + FAST0_NUM
-        clrf    TIMER0H + FAST1_NUM
-        clrf    TIMER0H + FAST2_NUM
-        clrf    TIMER0H + FAST3_NUM
-        clrf    TIMER0H + SLOW0_NUM
-        clrf    TIMER0H + SLOW1_NUM
-        clrf    TIMER0H + SLOW2_NUM
-        clrf    TIMER0H + SLOW3_NUM
+;;; //////////
 
-        clrf    CH_RDY
-        movlw   0xFF
-        movwf   WAITING
-        movwf   PHASE           ; Mark every channel as having a framing error,
-                                ; this will make sure the first sentence is right
-        clrf    DONE
+store_f2b:
+        mv_char2 FAST2_NUM
 
-        clrf    CH_BUSY
+;;; //////////
 
-        clrf    READF0
-        clrf    READF1
-        clrf    READF2
-        clrf    READF3
-        clrf    READS0
-        clrf    READS1
-        clrf    READS2
-        clrf    READS3
+store_f3b:
+        mv_char2 FAST3_NUM
 
-        movlw   0x80
-        movwf   SEND_BK
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        clrf    Q_START
-        clrf    Q_END
+;;; 36 cycles including call and return. If a char is waiting in our
+;;; own transmit queue, move it to the built-in one. Otherwise check if
+;;; we need to do something regarding sending, or send data from banks.
+send_step:
+        btfsc   SD_CH_FLAGS, SD_CH_BIT
+        goto    send_char
+        btfsc   SEND_BK, 7
+        goto    send_check      ; We are not sending
 
-        movlw   BANK_MASKL      ; Mark free banks as such
-        movwf   BK_FREEL
-        movlw   BANK_MASKH
-        movwf   BK_FREEH
+        goto    send            ; 6 cycles at send
 
-        movlw   6
-        movwf   FSR0H           ; Reset FSR0H to point to bank 12
+send_char:                      ; 3 cycles to here
+        btfss   PIR1, TXIF
+        goto    rreturn_in_29   ; 33 cycles to here, no room
 
-        movlb   12
+        btfsc   T2CON, TMR2ON
+        btfsc   PIR1, TMR2IF
+        goto    send_char_ok    ; timer not running or has expired
 
-        clrf    SEND_CNT
-        clrf    SEND_CNT + 1
-        clrf    SEND_CNT + 2
-        clrf    SEND_CNT + 3
+        goto    rreturn_in_25   ; 33 cycles to here, timer running and not expired
+
+send_char_ok:                   ; 9 cycles to here
+        bcf     PIR1, TMR2IF
+        bcf     T2CON, TMR2ON
+
+        movfw   SEND_CHAR
+        sublw   '\n'
+        btfsc   STATUS, Z
+        bsf     T2CON, TMR2ON   ; start timer when newline
 
-        clrf    CNT_LONG
-        clrf    ERR_CHN_LONG
-        clrf    CNT_STUCK
-        clrf    ERR_CHN_STUCK
+        movfw   SEND_CHAR
+        bcf     SD_CH_FLAGS, SD_CH_BIT
 
+        movlb   3
+        movwf   TXREG
         movlb   0
 
-        clrf    ACTIVE
+        goto    rreturn_in_13   ; 33 cycles to here
 
-        clrf    STUCK_MODE2
-        movlw   0x08
-        movwf   STUCK_MODE1     ; start at 0x0008
+send_check:                     ; 5 cycles to here
+        movfw   Q_END
+        subwf   Q_START, W
 
-        clrf    CNT_CONGEST
-        clrf    ERR_CHN_CONGEST
-        clrf    CNT_FRAME
-        clrf    ERR_CHN_FRAME
-        clrf    CNT_BINARY
-        clrf    ERR_CHN_BINARY
+        btfsc   STATUS, Z
+        goto    rreturn_in_25   ; Nothing is awaiting being sent, 33 cycles to here
 
-        clrf    TM1H
-        clrf    TM1L
+        movfw   Q_START
+        addlw   LOW(QUEUE)
+        movwf   FSR0L           ; FSRH:L points to the first element in the queue
 
-        movlw   0xFF
-        movwf   TM2H
-        movwf   TM2L
+        movfw   INDF0           ; W = bank to be sent
+        movwf   SEND_BK
 
-        bcf     TM_VALID_FLAGS, TM_VALID_BIT
-        bcf     SD_CH_FLAGS, SD_CH_BIT ; No char to send
+        btfsc   CHN_OUT_FLAGS, CHN_OUT_BIT
+        bsf     SEND_BK, 4
+        bsf     SEND_BK, 6
 
-        movlw   0xFF
-        movwf   BANK0 + 0
-        movwf   BANK0 + 1
-        movwf   BANK0 + 2
-        movwf   BANK0 + 3
-        movwf   BANK0 + 4
-        movwf   BANK0 + 5
-        movwf   BANK0 + 6
-        movwf   BANK0 + 7
+        incf    Q_START, f
+        bcf     Q_START, 4      ; start over at 16
 
-        movlb   12
+        goto    rreturn_in_14   ; 33 cycles to here
 
-        movwf   REF0 + 1
-        movwf   REF0 + 2
-        movwf   REF0 + 3
-        movwf   REF0 + 4
-        movwf   REF0 + 5
-        movwf   REF0 + 6
-        movwf   REF0 + 7
-        movwf   REF0 + 8
-        movwf   REF0 + 9
-        movwf   REF0 + 10
-        movwf   REF0 + 11
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        movlb   3
+;;; 16 cycles including call and return. Free the bank given by W.
+free_bank:
+        movwf   FSR0L           ; FSR0L is not used for anything else
+        movlw   0x01
+        btfsc   FSR0L, 1
+        movlw   0x04
+        btfsc   FSR0L, 0
+        lslf    WREG, f
+        btfsc   FSR0L, 2
+        swapf   WREG, f
+        btfss   FSR0L, 3
+        iorwf   BK_FREEL, f
+        btfsc   FSR0L, 3
+        iorwf   BK_FREEH, f
 
-        btfss   TX1STA, TRMT    ; Wait for trasmission to finish
-        goto    $-1             ; before setting speed
+        return                  ; 13 cycles to here
 
-        movlb   12
+;;; /////////////////////////////////////////////////////////////////////////////
 
-        movfw   INTER_SPEED
+;;; SEND_BK   10000000: not sending
+;;; SEND_BK   0100xxxx: getting ready to send from bank xxxx
+;;; SEND_BK   0101xxxx: getting ready to send from bank xxxx
+;;; SEND_BK   0010xxxx: finish of sending from bank xxxx
+;;; SEND_BK   0011xxxx: more finish of sending from bank xxxx
+;;; SEND_BK   0000xxxx: sending from bank xxxx
 
-        movlb   0
+;;; Part of send_step, sends data from banks. Our own transmit queue
+;;; is empty when we get here. Data chars go directly to the built-in
+;;; queue when there is room, so every send_step can send a char.
+send:                           ; 6 cycles to here
+        btfsc   SEND_BK, 5
+        goto    send_finish
+        btfsc   SEND_BK, 6
+        goto    send_setup
 
-        btfsc   STATUS, Z
-        call    speed_4800
+do_send:                        ; 10 cycles to here
+        movfw   SEND_END
+        subwf   FSR1L, W
 
-        decf    WREG, W
         btfsc   STATUS, Z
-        call    speed_38400
+        goto    do_send_last
 
-        decf    WREG, W
-        btfsc   STATUS, Z
-        call    speed_115200
+;;; Not last position
+        movfw   INDF1
+        incf    FSR1L, f        ; Move pointer
 
-        movlb   2
+        btfss   PIR1, TXIF
+        goto    do_send_busy    ; No room in built-in queue
 
-        movlw   0x82
-        movwf   FVRCON          ; Enable fixed voltage reference, set to 2.048 V for A/D conversion
+        btfsc   T2CON, TMR2ON
+        goto    do_send_queue   ; Timer running after newline, let send_char handle it
 
-        btfss   FVRCON, FVRRDY
-        goto    $-1             ; Wait for voltage reference to be ready
+        movlb   3
+        movwf   TXREG
+        movlb   0
 
-        movlb   1
+        goto    rreturn_in_10   ; 33 cycles to here
 
-        movlw   0x7D
-        movwf   ADCON0          ; A/D conversion on and set to fixed voltage reference
+do_send_busy:                   ; 19 cycles to here
+        nopm    2
 
-        movlw   0x60
-        movwf   ADCON1          ; A/D conversion result left justified, clock Fosc/64, Vss and Vdd refs
+do_send_queue:                  ; 21 cycles to here
+        movwf   SEND_CHAR
+        bsf     SD_CH_FLAGS, SD_CH_BIT
 
-        movlb   0
+        goto    rreturn_in_10   ; 33 cycles to here
 
-        return
+do_send_last:                   ; 15 cycles to here
+        bsf     SEND_BK, 5      ; Stop sending
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        movlw   '\r'
+        btfss   NEWLINE_FLAGS, NEWLINE_BIT
+        movlw   '\n'
 
-init3:
-        movlb   1
+        movwf   SEND_CHAR
+        bsf     SD_CH_FLAGS, SD_CH_BIT
 
-        bsf     ADCON0, GO_NOT_DONE
-        btfsc   ADCON0, GO_NOT_DONE
-        goto    $-1             ; Wait for A/D conversion to be done
+        goto    rreturn_in_12   ; 33 cycles to here
 
-        movlw   0x00
-        movwf   ADCON0          ; Disable A/D conversion
+send_setup:                     ; 11 cycles to here
+        btfsc   SEND_BK, 4
+        goto    send_setup2
+        movlw   LOW(PTR0)
+        movwf   FSR0L
 
-        movlb   2
+        bcf     SEND_BK, 6
+        movfw   SEND_BK
+        movwf   FSR1H
+        addwf   FSR0L, f        ; FSR0H:L points to pointer for relevant bank
 
-        movlw   0x00
-        movwf   FVRCON          ; Disable fixed voltage reference
+        movfw   INDF0
+        movwf   SEND_END        ; SEND_END is the pointer to the byte after the last in the bank
 
-        movlb   0
+        movlw   0x40
+        movwf   FSR1L
+        lsrf    FSR1H, f
+        rrf     FSR1L, f        ; FSR1H:L points to first byte of data to be sent
 
-        return
+        goto    rreturn_in_8    ; 33 cycles to here
 
-;;; /////////////////////////////////////////////////////////////////////////////
+send_setup2:                    ; 14 cycles to here
+        bcf     SEND_BK, 4
 
-;;; Wait a little
-wait_100ms:
-        movlw   0x04            ; Take a break of about 100 ms (clock is 32 MHz)
-        movwf   CHAR0
-        clrf    CHAR0 + 1
-        clrf    CHAR0 + 2
-wait_100ms_lp:
-        decfsz  CHAR0 + 2, f
-        goto    wait_100ms_lp
-        decfsz  CHAR0 + 1, f
-        goto    wait_100ms_lp
-        decfsz  CHAR0, f
-        goto    wait_100ms_lp
+        movfw   SEND_BK
+        addlw   LOW(REF0) - 0x40 ; Account for bit 6 being set in SEND_BK
+        movwf   FSR0L           ; FSR0H:L points to reference
 
-        return
+        movfw   INDF0
+        andlw   0x07            ; Skip address filter mark
+        addlw   '1'
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        movwf   SEND_CHAR
+        bsf     SD_CH_FLAGS, SD_CH_BIT
 
-;;; Set serial speed to 4,800 baud.
-speed_4800:
-        movlb   3
-        movlw   6
-        movwf   SP1BRGH
-        movlw   130
-        movwf   SP1BRGL         ; 4,799 baud
-        movlb   0
+        goto    rreturn_in_10   ; 33 cycles to here
 
-        movlw   0x2B
-        movwf   T2CON           ; off, postscaler 6, prescaler 64 for 6240 us or 30 bits
+send_finish:                    ; 9 cycles to here
+        btfss   NEWLINE_FLAGS, NEWLINE_BIT
+        goto    send_finish1
+;;; Return-newline mode
 
-        return
+        btfsc   SEND_BK, 4
+        goto    send_finish2
 
-;;; /////////////////////////////////////////////////////////////////////////////
+        movlw   0x01
+        btfsc   SEND_BK, 1
+        movlw   0x04
+        btfsc   SEND_BK, 0
+        lslf    WREG, f
+        btfsc   SEND_BK, 2
+        swapf   WREG, f
+        btfss   SEND_BK, 3
+        iorwf   BK_FREEL, f
+        btfsc   SEND_BK, 3
+        iorwf   BK_FREEH, f
 
-;;; Set serial speed to 38,400 baud.
-speed_38400:
-        movlb   3
-        clrf    SP1BRGH
-        movlw   207
-        movwf   SP1BRGL         ; 38,462 baud
-        movlb   0
+;;; The bank is now marked as free
+        bsf     SEND_BK, 4      ; do send_finish2 next time
 
-        movlw   0x12
-        movwf   T2CON           ; off, postscaler 3, prescaler 16 for 780 us or 30 bits
+        goto    rreturn_in_8    ; 33 cycles to here
 
-        return
+;;; Newline only mode
+send_finish1:                   ; 12 cycles to here
+        movlw   0x01
+        btfsc   SEND_BK, 1
+        movlw   0x04
+        btfsc   SEND_BK, 0
+        lslf    WREG, f
+        btfsc   SEND_BK, 2
+        swapf   WREG, f
+        btfss   SEND_BK, 3
+        iorwf   BK_FREEL, f
+        btfsc   SEND_BK, 3
+        iorwf   BK_FREEH, f
 
-;;; /////////////////////////////////////////////////////////////////////////////
+;;; The bank is now marked as free
+        movlw   0x80
+        movwf   SEND_BK         ; We are done sending
 
-;;; Set serial speed to 115,200 baud.
-speed_115200:
-        movlb   3
-        clrf    SP1BRGH
-        movlw   68
-        movwf   SP1BRGL         ; 115,942 baud
-        movlb   0
+        goto    rreturn_in_8    ; 33 cycles to here
 
-        movlw   0x02
-        movwf   T2CON           ; off, postscaler 1, prescaler 16 for 260 us or 30 bits
+send_finish2:                   ; 14 cycles to here
+        movlw   '\n'
 
-        return
+        movwf   SEND_CHAR
+        bsf     SD_CH_FLAGS, SD_CH_BIT
+
+        movlw   0x80
+        movwf   SEND_BK         ; We are done sending
+
+        goto    rreturn_in_14   ; 33 cycles to here
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-;;; A goto to one of these is a delayed return here in the veryfar section.
-vreturn_in_30:
-        nop
-vreturn_in_29:
+;;; A goto to one of these is a delayed return here in the remote section.
+rreturn_in_29:
         nop
-vreturn_in_28:
+rreturn_in_28:
         nop
-vreturn_in_27:
+rreturn_in_27:
         nop
-vreturn_in_26:
+rreturn_in_26:
         nop
-vreturn_in_25:
+rreturn_in_25:
         nop
-vreturn_in_24:
+rreturn_in_24:
         nop
-vreturn_in_23:
+rreturn_in_23:
         nop
-vreturn_in_22:
+rreturn_in_22:
         nop
-vreturn_in_21:
+rreturn_in_21:
         nop
-vreturn_in_20:
+rreturn_in_20:
         nop
-vreturn_in_19:
+rreturn_in_19:
         nop
-vreturn_in_18:
+rreturn_in_18:
         nop
-vreturn_in_17:
+rreturn_in_17:
         nop
-vreturn_in_16:
+rreturn_in_16:
         nop
-vreturn_in_15:
+rreturn_in_15:
         nop
-vreturn_in_14:
+rreturn_in_14:
         nop
-vreturn_in_13:
+rreturn_in_13:
         nop
-vreturn_in_12:
+rreturn_in_12:
         nop
-vreturn_in_11:
+rreturn_in_11:
         nop
-vreturn_in_10:
+rreturn_in_10:
         nop
-vreturn_in_9:
+rreturn_in_9:
         nop
-vreturn_in_8:
+rreturn_in_8:
         nop
-vreturn_in_7:
+rreturn_in_7:
         nop
-vreturn_in_6:
+rreturn_in_6:
         nop
-vreturn_in_5:
+rreturn_in_5:
         nop
-vreturn_in_4:
+rreturn_in_4:
         nop
-vreturn_in_3:
+rreturn_in_3:
         return
 
 ;;; /////////////////////////////////////////////////////////////////////////////
 ;;; Settings sections starts here.
 ;;; /////////////////////////////////////////////////////////////////////////////
 
-facset  code    0x1F60
+facset  code    0x1F20
 
 factory_settings:
         settings
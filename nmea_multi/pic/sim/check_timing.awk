@@ -0,0 +1,187 @@
+#!/usr/bin/awk -f
+
+# Copyright 2020 Bjarne Knudsen
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted
+# provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice, this list of
+# conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+# conditions and the following disclaimer in the documentation and/or other materials provided
+# with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+# endorse or promote products derived from this software without specific prior written
+# permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+# IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+# FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# Checks the timing of port reads in a gpsim log and extracts the
+# characters written to the UART.
+#
+# The fast port must be read every 52 or 53 cycles and any 64
+# consecutive reads must span exactly one main loop of 3,333
+# cycles. The slow port must be read every 416 or 417 cycles and any
+# 8 consecutive reads must span one main loop. Reads of the fast port
+# that come too early to be input reads are counted as other reads
+# (the configuration pin in chk_input). There must be exactly one of
+# these per main loop, so a read that comes early by mistake is
+# caught as well.
+#
+# Variables (set with -v):
+#
+#   fast:  pattern matching the fast port in a log line, default "porta"
+#   slow:  pattern matching the slow port in a log line, default "portc"
+#   tx:    pattern matching the UART transmit register, default "txreg"
+#   out:   file to write the transmitted characters to
+#
+# The cycle of a log line is the first hex number on it. The value
+# written is the first hex number after the word "wrote" or "write".
+
+BEGIN {
+    if (fast == "") {
+        fast = "porta"
+    }
+
+    if (slow == "") {
+        slow = "portc"
+    }
+
+    if (tx == "") {
+        tx = "tx1?reg"
+    }
+
+    LOOP = 3333
+    FAST_GAP = 52
+    FAST_READS = 64
+    SLOW_GAP = 416
+    SLOW_READS = 8
+
+    errors = 0
+}
+
+function hex(h,    v, k) {
+    v = 0
+    h = tolower(substr(h, 3))
+
+    for (k = 1; k <= length(h); k++) {
+        v = v * 16 + index("0123456789abcdef", substr(h, k, 1)) - 1
+    }
+
+    return v
+}
+
+function error(cycle, msg) {
+    if (errors < 20) {
+        printf("Error at cycle %d: %s\n", cycle, msg)
+    }
+
+    errors++
+}
+
+# Check the gap since the last read of a port along with the time
+# span of the last count reads.
+function chain(port, cycle, gap, count,    g, k) {
+    if (last[port] == "") {
+        last[port] = cycle
+        return
+    }
+
+    g = cycle - last[port]
+    last[port] = cycle
+    reads[port]++
+
+    if (g != gap && g != gap + 1) {
+        error(cycle, sprintf("%s port read after %d cycles", port, g))
+    }
+
+    k = reads[port] % count
+
+    if (reads[port] > count) {
+        sum[port] -= gaps[port, k]
+    }
+
+    gaps[port, k] = g
+    sum[port] += g
+
+    if (reads[port] >= count && sum[port] != LOOP) {
+        error(cycle, sprintf("%d %s port reads took %d cycles", count, port, sum[port]))
+    }
+}
+
+{
+    line = tolower($0)
+    cycle = -1
+    value = -1
+
+    for (i = 1; i <= NF; i++) {
+        if (cycle == -1 && tolower($i) ~ /^0x[0-9a-f]+$/) {
+            cycle = hex($i)
+        }
+
+        if (tolower($i) ~ /^wr(ote|ite)/) {
+            for (j = i + 1; j <= NF; j++) {
+                if (tolower($j) ~ /^0x[0-9a-f]+/) {
+                    value = hex($j)
+                    break
+                }
+            }
+        }
+    }
+
+    if (cycle == -1) {
+        next
+    }
+
+    if (line ~ tx && value != -1) {
+        if (out != "") {
+            printf("%c", value) > out
+        }
+
+        sent++
+    }
+    else if (line ~ fast && line ~ /read/) {
+        if (last["fast"] != "" && cycle - last["fast"] < FAST_GAP) {
+            # not an input read
+            if (last_other != "" && cycle - last_other != LOOP) {
+                error(cycle, sprintf("other fast port read after %d cycles", cycle - last_other))
+            }
+
+            last_other = cycle
+            others++
+        }
+        else {
+            chain("fast", cycle, FAST_GAP, FAST_READS)
+        }
+    }
+    else if (line ~ slow && line ~ /read/) {
+        chain("slow", cycle, SLOW_GAP, SLOW_READS)
+    }
+}
+
+END {
+    printf("Fast port reads: %d, other fast port reads: %d, slow port reads: %d\n",
+           reads["fast"], others, reads["slow"])
+    printf("Characters sent: %d\n", sent)
+
+    if (reads["fast"] < FAST_READS || reads["slow"] < SLOW_READS) {
+        error(cycle, "too few reads logged")
+    }
+
+    if (errors > 0) {
+        printf("%d timing errors\n", errors)
+        exit 1
+    }
+
+    printf("Timing ok\n")
+}
@@ -0,0 +1,140 @@
+#!/bin/sh
+
+# Copyright 2020 Bjarne Knudsen
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted
+# provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice, this list of
+# conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+# conditions and the following disclaimer in the documentation and/or other materials provided
+# with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+# endorse or promote products derived from this software without specific prior written
+# permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+# IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+# FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# Runs the simulation build of the firmware in gpsim with the input
+# files in sim/input driving the eight input pins. The timing of the
+# port reads is checked and the UART output is compared to
+# sim/golden.txt.
+#
+# Environment variables:
+#
+#   GPSIM:   the gpsim program, default gpsim
+#   SIM_SECONDS: simulated seconds, default 16. This is long enough
+#            for the unfinished sentence on channel 8 to be dropped as
+#            stuck.
+#   GOLDEN:  set to "update" to save the output as the new golden file
+#            and the report of the run as sim/golden.log
+
+set -e
+
+DIR=`dirname "$0"`
+COD="$DIR/../nmea_multi_sim.cod"
+LST="$DIR/../nmea_multi_sim.lst"
+WORK="$DIR/work"
+GPSIM=${GPSIM:-gpsim}
+SIM_SECONDS=${SIM_SECONDS:-16}
+
+CYCLES=8000000                  # instruction cycles per second at 32 MHz
+START=2000000                   # cycle for the first input, after the start up delays
+
+mkdir -p "$WORK"
+
+# Address of a symbol from the symbol table of the assembler listing
+sym() {
+    awk -v name=$1 '
+        /^SYMBOL TABLE/ { table = 1 }
+        table && NF == 2 && $1 == name { print "0x" $2; found = 1; exit }
+        END { if (!found) { print "Symbol " name " not found in " FILENAME > "/dev/stderr"; exit 1 } }
+    ' "$LST"
+}
+
+COUNTERS="CNT_CONGEST CNT_FRAME CNT_BINARY CNT_LONG CNT_STUCK CNT_CHECKSUM CNT_FILTER"
+ADDRESSES=
+for c in $COUNTERS; do
+    ADDRESSES="$ADDRESSES `sym $c`"
+done
+
+# Channel, pin, baud rate. The simulation settings have channels 1-3
+# fast and channel 4 as a fast port channel in slow mode.
+stim() {
+    awk -v name=ch$1 -v pin=$2 -v baud=$3 -v start=$START -v cycles=$CYCLES \
+        -f "$DIR/stim.awk" "$DIR/input/ch$1.txt"
+}
+
+{
+    echo "load $COD"
+
+    stim 1 porta1 38400
+    stim 2 porta0 38400
+    stim 3 porta5 38400
+    stim 4 porta3 4800
+    stim 5 portc5 4800
+    stim 6 portc4 4800
+    stim 7 portc3 4800
+    stim 8 portc2 4800
+
+    # The configuration pin is kept high so interactive mode is never entered
+    echo "stimulus asynchronous_stimulus"
+    echo "initial_state 1"
+    echo "start_cycle 0"
+    echo "{ 0, 1 }"
+    echo "name config"
+    echo "end"
+    echo "node n_config"
+    echo "attach n_config config porta2"
+
+    # PORTA, PORTC and TX1REG
+    echo "log on $WORK/sim.log"
+    echo "log r 0x00C"
+    echo "log r 0x00E"
+    echo "log w 0x19A"
+
+    echo "break c `expr $SIM_SECONDS \* $CYCLES`"
+    echo "run"
+    echo "log off"
+
+    for a in $ADDRESSES; do
+        echo "x $a"
+    done
+
+    echo "quit"
+} > "$WORK/sim.stc"
+
+"$GPSIM" -i -c "$WORK/sim.stc" > "$WORK/gpsim.out" 2>&1
+
+{
+    echo "Counters ($COUNTERS):"
+    tail -n 8 "$WORK/gpsim.out"
+    awk -v out="$WORK/out.txt" -f "$DIR/check_timing.awk" "$WORK/sim.log"
+} > "$WORK/report.txt" || { cat "$WORK/report.txt"; exit 1; }
+cat "$WORK/report.txt"
+
+if [ "$GOLDEN" = "update" ]; then
+    cp "$WORK/out.txt" "$DIR/golden.txt"
+    cp "$WORK/report.txt" "$DIR/golden.log"
+    echo "Golden output updated"
+elif [ ! -f "$DIR/golden.txt" ]; then
+    echo "No golden output, run with GOLDEN=update to save this output as golden"
+    exit 1
+elif cmp -s "$WORK/out.txt" "$DIR/golden.txt"; then
+    echo "Output matches golden"
+else
+    diff "$DIR/golden.txt" "$WORK/out.txt" || true
+    echo "Output differs from golden"
+    exit 1
+fi
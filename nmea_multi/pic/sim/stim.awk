@@ -0,0 +1,191 @@
+#!/usr/bin/awk -f
+
+# Copyright 2020 Bjarne Knudsen
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted
+# provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice, this list of
+# conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+# conditions and the following disclaimer in the documentation and/or other materials provided
+# with the distribution.
+#
+# 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+# endorse or promote products derived from this software without specific prior written
+# permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+# IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+# FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+# OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+# Converts a text file with NMEA sentences to a gpsim stimulus for
+# one input pin. The signal is as seen by the PIC: idle high, start
+# bit low, eight data bits with the lowest first and a high stop bit.
+#
+# Variables (set with -v):
+#
+#   name:   stimulus name
+#   pin:    gpsim pin name, for example porta1
+#   baud:   baud rate of the channel
+#   start:  cycle for the first start bit
+#   cycles: instruction cycles per second (8,000,000 at 32 MHz)
+#
+# Each line of input is sent followed by return and newline except
+# for these:
+#
+#   Lines ending in "~" are sent without return and newline. This
+#   leaves the sentence unfinished (stuck).
+#
+#   "#gap <ms>" keeps the line idle for that long.
+#
+#   "#at <ms>" keeps the line idle until that long after start. This
+#   lines up bursts on several channels.
+#
+#   "#break <ms>" keeps the line low for that long (frame error).
+#
+#   "#hex <hh>" sends a single character given in hex.
+#
+#   "#repeat <n>" sends the next line n times back to back.
+
+BEGIN {
+    if (cycles == 0) {
+        cycles = 8000000
+    }
+
+    bit = cycles / baud
+    t = start                   # exact time, rounded when output
+    last = 1                    # initial state
+
+    for (i = 1; i < 256; i++) {
+        code[sprintf("%c", i)] = i
+    }
+
+    printf("stimulus asynchronous_stimulus\n")
+    printf("initial_state 1\n")
+    printf("start_cycle 0\n")
+    n = 0
+    repeat = 1
+}
+
+function level(v) {
+    if (v != last) {
+        data[n++] = sprintf("  %d, %d", int(t + 0.5), v)
+        last = v
+    }
+}
+
+function hex(h,    v, k) {
+    v = 0
+
+    for (k = 1; k <= length(h); k++) {
+        v = v * 16 + index("0123456789abcdef", tolower(substr(h, k, 1))) - 1
+    }
+
+    return v
+}
+
+function send_char(c,    k) {
+    level(0)
+    t += bit
+
+    for (k = 0; k < 8; k++) {
+        level(c % 2)
+        c = int(c / 2)
+        t += bit
+    }
+
+    level(1)
+    t += bit
+}
+
+$1 == "#gap" {
+    level(1)
+    t += $2 * cycles / 1000
+    next
+}
+
+$1 == "#at" {
+    level(1)
+
+    if (t > start + $2 * cycles / 1000) {
+        printf("%s: #at %s is too early\n", name, $2) > "/dev/stderr"
+        failed = 1
+        exit 1
+    }
+
+    t = start + $2 * cycles / 1000
+    next
+}
+
+$1 == "#break" {
+    level(0)
+    t += $2 * cycles / 1000
+    level(1)
+    t += bit
+    next
+}
+
+$1 == "#hex" {
+    send_char(hex($2))
+    next
+}
+
+$1 == "#repeat" {
+    repeat = $2
+    next
+}
+
+{
+    s = $0
+    finish = 1
+
+    if (substr(s, length(s)) == "~") {
+        s = substr(s, 1, length(s) - 1)
+        finish = 0
+    }
+
+    for (r = 0; r < repeat; r++) {
+        for (j = 1; j <= length(s); j++) {
+            send_char(code[substr(s, j, 1)])
+        }
+
+        if (finish) {
+            send_char(13)
+            send_char(10)
+        }
+    }
+
+    repeat = 1
+}
+
+END {
+    if (failed) {
+        exit 1
+    }
+
+    level(1)                    # always end with a high level
+
+    if (n == 0) {
+        data[n++] = "  0, 1"    # idle channel
+    }
+
+    printf("{\n")
+
+    for (k = 0; k < n; k++) {
+        printf("%s%s\n", data[k], (k < n - 1) ? "," : "")
+    }
+
+    printf("}\n")
+    printf("name %s\n", name)
+    printf("end\n")
+    printf("node n_%s\n", name)
+    printf("attach n_%s %s %s\n", name, name, pin)
+}
@@ -54,8 +54,8 @@ void  usage() {
   fprintf(stderr, "\n");
   fprintf(stderr, "  -h: print this help.\n");
   fprintf(stderr, "\n");
-  fprintf(stderr, "  -b <rate>: one of these: 4800, 38400, 115200. Default is 4800 and almost\n");
-  fprintf(stderr, "        always right.\n");
+  fprintf(stderr, "  -b <rate>: any baud rate, typically 4800, 38400 or 115200. Default is 4800\n");
+  fprintf(stderr, "        and almost always right.\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "  -i <device>: a tty input device. /dev/ttyAMA0 is default.\n");
   fprintf(stderr, "\n");
@@ -119,7 +119,7 @@ int  main( int     argc,
         usage();
       }
 
-      if (baud != 4800 && baud != 38400 && baud != 115200) {
+      if (baud <= 0) {
         fprintf(stderr, "Wrong baud rate\n");
         usage();
       }
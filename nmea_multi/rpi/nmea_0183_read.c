@@ -31,6 +31,7 @@
 #include <gpiod.h>
 
 #include "nmea_0183_utils.h"
+#include "nmea_trace.h"
 
 #define MAX_LINE         1024
 
@@ -43,27 +44,65 @@ void  usage() {
   fprintf(stderr, "\n");
   fprintf(stderr, "  -h: print this help.\n");
   fprintf(stderr, "\n");
-  fprintf(stderr, "  -b <rate>: one of these: 4800, 38400, 115200. Default is 115000.\n");
+  fprintf(stderr, "  -b <rate>: any baud rate, typically 4800, 38400, 115200, 230400 or 460800.\n");
+  fprintf(stderr, "        Default is 115200.\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "  -i <device>: a tty input device or \"-\" for stdin. /dev/ttyAMA0 is default.\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "  -g <pin>: GPIO pin for config mode, \"-\" for no pin. %d is default.\n", CONFIG_GPIO);
   fprintf(stderr, "\n");
+  fprintf(stderr, "  -r <mode>: how to read the input, one of these:\n");
+  fprintf(stderr, "        stdio: buffered reads through stdio, the default.\n");
+  fprintf(stderr, "        block: blocking reads on the raw tty returning as soon as data arrives.\n");
+  fprintf(stderr, "        poll: poll for data on the raw tty, allows the -d option.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -d <ms>: output a partial sentence when it has waited this many milliseconds\n");
+  fprintf(stderr, "        for the rest. Only for the poll mode. Default is to wait.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -l: set the low latency flag on the tty if the driver supports it.\n");
+  fprintf(stderr, "\n");
 
   exit(1);
 }
 
 
+// Open the input and make a reader for it according to the options.
+tty_reader_t*  open_reader( char*  input_name,
+                            int    baud,
+                            int    mode,
+                            int    deadline,
+                            int    low_latency )
+{
+  int  fd;
+
+  // VMIN of 1 and VTIME of 0 makes reads return as soon as anything
+  // has arrived.
+  fd  =  open_tty_fd(input_name, baud, 0, 1, 0);
+
+  if (low_latency && input_name != NULL && set_tty_low_latency(fd) != 0) {
+    fprintf(stderr, "Low latency not supported by %s\n", input_name);
+  }
+
+  return  tty_reader_open(fd, mode, deadline, 0);
+}
+
+
 int  main( int     argc,
            char**  argv )
 {
   struct gpiod_chip*  chip        =  NULL;
   struct gpiod_line*  line        =  NULL;
-  FILE*               in_fp;
+  tty_reader_t*       reader;
   char*               input_name  =  NULL;
   int                 baud        =  -1;
   int                 gpio        =  -2; // -2 is not set, -1 is no gpio
+  int                 mode        =  -1;
+  int                 deadline    =  -1;
+  int                 low_latency =  0;
   int                 p           =  1;
+  int                 used;
+  int                 channel;
+  uint32_t            id          =  0;  // sentence number for tracing
   int                 i;
   char                s[MAX_LINE];
 
@@ -87,13 +126,55 @@ int  main( int     argc,
         usage();
       }
 
-      if (baud != 4800 && baud != 38400 && baud != 115200) {
+      if (baud <= 0) {
         fprintf(stderr, "Wrong baud rate\n");
         usage();
       }
 
       p  +=  2;
     }
+    else if (strcmp(argv[p], "-r") == 0) {
+      if (mode != -1) {
+        fprintf(stderr, "Read mode given twice\n");
+        usage();
+      }
+
+      if (p + 1 >= argc) {
+        fprintf(stderr, "No read mode given\n");
+        usage();
+      }
+
+      mode  =  tty_read_mode(argv[p + 1]);
+
+      if (mode == -1) {
+        fprintf(stderr, "Wrong read mode\n");
+        usage();
+      }
+
+      p  +=  2;
+    }
+    else if (strcmp(argv[p], "-d") == 0) {
+      if (deadline != -1) {
+        fprintf(stderr, "Deadline given twice\n");
+        usage();
+      }
+
+      if (p + 1 >= argc) {
+        fprintf(stderr, "No deadline given\n");
+        usage();
+      }
+
+      if (sscanf(argv[p + 1], "%d%n", &deadline, &i) < 1 || argv[p + 1][i] != '\0' || deadline < 0) {
+        fprintf(stderr, "Wrong deadline\n");
+        usage();
+      }
+
+      p  +=  2;
+    }
+    else if (strcmp(argv[p], "-l") == 0) {
+      low_latency  =  1;
+      p++;
+    }
     else if (strcmp(argv[p], "-i") == 0) {
       if (input_name != NULL) {
         fprintf(stderr, "Input device given twice\n");
@@ -139,6 +220,15 @@ int  main( int     argc,
     baud  =  115200;
   }
 
+  if (mode == -1) {
+    mode  =  TTY_READ_STDIO;
+  }
+
+  if (deadline != -1 && mode != TTY_READ_POLL) {
+    fprintf(stderr, "Deadline needs the poll read mode\n");
+    usage();
+  }
+
   if (input_name == NULL) {
     input_name  =  "/dev/ttyAMA0";
   }
@@ -160,9 +250,16 @@ int  main( int     argc,
     }
   }
 
-  in_fp  =  open_tty_file(input_name, baud, 0);
+  TRACE_INIT("nmea_0183_read");
+
+  reader  =  open_reader(input_name, baud, mode, deadline, low_latency);
+
+  while (tty_read_sentence(reader, s, MAX_LINE) > 0) {
+    id       =  reader->id;     // the id of the tty reads of this sentence
+    channel  =  s[0] >= '1' && s[0] <= '8' ? s[0] - '0' : 0;
+
+    TRACE_BEGIN(TRACE_GPIO_CHECK, channel, id);
 
-  while (fgets(s, MAX_LINE, in_fp) != NULL) {
     // we need this to update used status
     line  =  gpiod_chip_get_line(chip, gpio);
 
@@ -171,12 +268,16 @@ int  main( int     argc,
       exit(1);
     }
 
-    if (gpio != -1 && gpiod_line_is_used(line)) {
+    used  =  gpio != -1 && gpiod_line_is_used(line);
+
+    TRACE_END(TRACE_GPIO_CHECK, channel, id);
+
+    if (used) {
       // configuration, discard string read
 
       fprintf(stderr, "Entering configuration mode\n");
 
-      close_tty_file(in_fp);
+      tty_reader_close(reader);
 
       while (gpiod_line_is_used(line)) {
         sleep(1);
@@ -191,11 +292,14 @@ int  main( int     argc,
 
       fprintf(stderr, "Exiting configuration mode\n");
 
-      in_fp  =  open_tty_file(input_name, baud, 0);
+      reader      =  open_reader(input_name, baud, mode, deadline, low_latency);
+      reader->id  =  id;        // keep the trace ids unique
     }
     else {
+      TRACE_BEGIN(TRACE_OUTPUT, channel, id);
       fputs(s, stdout);
       fflush(stdout);
+      TRACE_END(TRACE_OUTPUT, channel, id);
     }
   }
 
@@ -25,30 +25,103 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
-#include <termios.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+#include <linux/serial.h>
 
 #include "nmea_0183_utils.h"
+#include "nmea_trace.h"
 
-FILE*  open_tty_file( char*  name,
-		      int    baud,
-                      int    is_output )
+// asm/termbits.h is used instead of termios.h to get termios2 which
+// allows any baud rate through BOTHER. The two cannot be included
+// together.
+
+int  set_tty_attributes( int  fd,
+                         int  baud,
+                         int  is_output,
+                         int  vmin,
+                         int  vtime )
 {
-  FILE*           fp;
-  int             fd;
-  int             flags  =  O_NOCTTY | O_NDELAY;
-  struct termios  options;
+  struct termios2  options;
+
+  if (ioctl(fd, TCGETS2, &options) != 0) {
+    return  -1;
+  }
+
+  // same as cfmakeraw()
+  options.c_iflag  &=  ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+  options.c_oflag  &=  ~OPOST;
+  options.c_lflag  &=  ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+  options.c_cflag  &=  ~(CSIZE | PARENB);
+  options.c_cflag  |=  CS8;
+
+  options.c_cflag  &=  ~(CBAUD | (CBAUD << IBSHIFT));
+  options.c_cflag  |=  BOTHER | (BOTHER << IBSHIFT);
+  options.c_ispeed  =  baud;
+  options.c_ospeed  =  baud;
+
+  options.c_cflag  |=  CLOCAL;
+
+  if (!is_output) {
+    options.c_cflag     |=  CREAD;
+    options.c_cc[VMIN]   =  vmin;
+    options.c_cc[VTIME]  =  vtime;
+  }
+
+  if (ioctl(fd, TCSETS2, &options) != 0) {
+    return  -1;
+  }
+
+  return  0;
+}
+
+
+int  set_tty_low_latency( int  fd )
+{
+  struct serial_struct  serial;
+
+  if (ioctl(fd, TIOCGSERIAL, &serial) != 0) {
+    return  -1;
+  }
+
+  serial.flags  |=  ASYNC_LOW_LATENCY;
+
+  if (ioctl(fd, TIOCSSERIAL, &serial) != 0) {
+    return  -1;
+  }
+
+  return  0;
+}
+
+
+int  open_tty_fd( char*  name,
+                  int    baud,
+                  int    is_output,
+                  int    vmin,
+                  int    vtime )
+{
+  int  fd;
+  int  flags  =  O_NOCTTY | O_NDELAY;
 
   if (name == NULL) {
     if (is_output) {
-      return  stdout;
+      return  1;
     }
     else {
-      return  stdin;
+      return  0;
     }
   }
 
+  if (baud <= 0) {
+    fprintf(stderr, "Unknown baud rate: %d\n", baud);
+    exit(1);
+  }
+
   if (is_output) {
     flags  |=  O_WRONLY;
   }
@@ -68,40 +141,32 @@ FILE*  open_tty_file( char*  name,
     exit(1);
   }
 
-  if (tcgetattr(fd, &options) != 0) {
-    fprintf(stderr, "Error getting tty file attributes.\n");
+  if (set_tty_attributes(fd, baud, is_output, vmin, vtime) != 0) {
+    fprintf(stderr, "Error setting tty file attributes.\n");
     exit(1);
   }
 
-  cfmakeraw(&options);
+  return  fd;
+}
 
-  if (baud == 115200) {
-    cfsetispeed(&options, B115200);
-    cfsetospeed(&options, B115200);
-  }
-  else if (baud == 38400) {
-    cfsetispeed(&options, B38400);
-    cfsetospeed(&options, B38400);
-  }
-  else if (baud == 4800) {
-    cfsetispeed(&options, B4800);
-    cfsetospeed(&options, B4800);
-  }
-  else {
-    fprintf(stderr, "Unknown baud rate: %d\n", baud);
-    exit(1);
-  }
 
-  options.c_cflag  |=  CLOCAL;
+FILE*  open_tty_file( char*  name,
+		      int    baud,
+                      int    is_output )
+{
+  FILE*  fp;
+  int    fd;
 
-  if (!is_output) {
-    options.c_cflag  |=  CREAD;
+  if (name == NULL) {
+    if (is_output) {
+      return  stdout;
+    }
+    else {
+      return  stdin;
+    }
   }
 
-  if (tcsetattr(fd, TCSANOW, &options) != 0) {
-    fprintf(stderr, "Error setting tty file attributes.\n");
-    exit(1);
-  }
+  fd  =  open_tty_fd(name, baud, is_output, 1, 0);
 
   if (is_output) {
     fp  =  fdopen(fd, "w");
@@ -126,3 +191,252 @@ void  close_tty_file( FILE*  fp )
     exit(1);
   }
 }
+
+
+tty_reader_t*  tty_reader_open( int  fd,
+                                int  mode,
+                                int  deadline_ms,
+                                int  buf_size )
+{
+  tty_reader_t*  r  =  (tty_reader_t*) malloc(sizeof(tty_reader_t));
+
+  if (buf_size <= 0) {
+    buf_size  =  TTY_BUF_SIZE;
+  }
+
+  if (r == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+
+  r->fd           =  fd;
+  r->fp           =  NULL;
+  r->mode         =  mode;
+  r->deadline_ms  =  deadline_ms;
+  r->buf          =  NULL;
+  r->size         =  buf_size;
+  r->start        =  0;
+  r->scan         =  0;
+  r->end          =  0;
+  r->read_start   =  0;
+  r->id           =  0;
+
+  if (mode == TTY_READ_STDIO) {
+    r->fp  =  (fd == 0) ? stdin : fdopen(fd, "r");
+
+    if (r->fp == NULL) {
+      fprintf(stderr, "Error opening tty file.\n");
+      exit(1);
+    }
+  }
+  else {
+    r->buf  =  (char*) malloc(buf_size);
+
+    if (r->buf == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(1);
+    }
+  }
+
+  return  r;
+}
+
+
+// Milliseconds since the oldest byte not yet returned arrived.
+static int  partial_age_ms( tty_reader_t*  r )
+{
+  struct timespec  now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return  (now.tv_sec - r->partial_time.tv_sec) * 1000
+    + (now.tv_nsec - r->partial_time.tv_nsec) / 1000000;
+}
+
+
+// Channel of a sentence from its first char, 0 if it has none. For
+// tracing.
+static inline int  sentence_channel( char  c )
+{
+  return  c >= '1' && c <= '8' ? c - '0' : 0;
+}
+
+
+// Channel of the sentence being assembled if the buffer ends at end.
+static inline int  pending_channel( tty_reader_t*  r,
+                                    int            end )
+{
+  return  r->start < end ? sentence_channel(r->buf[r->start]) : 0;
+}
+
+
+// Move n bytes from the buffer to s and zero terminate.
+static int  take_sentence( tty_reader_t*  r,
+                           char*          s,
+                           int            n )
+{
+  memcpy(s, r->buf + r->start, n);
+  s[n]  =  '\0';
+
+  r->id++;
+
+  r->start  +=  n;
+
+  if (r->scan < r->start) {
+    r->scan  =  r->start;
+  }
+
+  if (r->start == r->end) {
+    r->start       =  0;
+    r->scan        =  0;
+    r->end         =  0;
+    r->read_start  =  0;
+  }
+  else if (r->start >= r->read_start) {
+    // the rest came with the last read, otherwise it started in an
+    // earlier read and partial_time is kept
+    r->partial_time  =  r->read_time;
+  }
+
+  return  n;
+}
+
+
+int  tty_read_sentence( tty_reader_t*  r,
+                        char*          s,
+                        int            max )
+{
+  int  n;
+
+  if (r->mode == TTY_READ_STDIO) {
+    char*  res;
+
+    TRACE_BEGIN(TRACE_TTY_READ, 0, r->id + 1);
+    res  =  fgets(s, max, r->fp);
+    TRACE_END(TRACE_TTY_READ, res != NULL ? sentence_channel(s[0]) : 0, r->id + 1);
+
+    if (res == NULL) {
+      return  0;
+    }
+
+    r->id++;
+
+    return  strlen(s);
+  }
+
+  while (1) {
+    for (; r->scan < r->end; r->scan++) {
+      if (r->scan - r->start == max - 1) {
+        return  take_sentence(r, s, max - 1);
+      }
+
+      if (r->buf[r->scan] == '\n') {
+        return  take_sentence(r, s, r->scan + 1 - r->start);
+      }
+    }
+
+    if (r->start < r->end && r->deadline_ms >= 0 && partial_age_ms(r) >= r->deadline_ms) {
+      // flush the partial sentence, the rest comes later
+      return  take_sentence(r, s, r->end - r->start);
+    }
+
+    if (r->end == r->size) {
+      memmove(r->buf, r->buf + r->start, r->end - r->start);
+      r->scan        -=  r->start;
+      r->end         -=  r->start;
+      r->read_start  -=  r->start;
+      r->start        =  0;
+    }
+
+    if (r->mode == TTY_READ_POLL) {
+      struct pollfd  pfd;
+      int            timeout  =  -1;
+
+      if (r->start < r->end && r->deadline_ms >= 0) {
+        timeout  =  r->deadline_ms - partial_age_ms(r);
+
+        if (timeout < 0) {
+          timeout  =  0;
+        }
+      }
+
+      pfd.fd      =  r->fd;
+      pfd.events  =  POLLIN;
+
+      n  =  poll(&pfd, 1, timeout);
+
+      if (n < 0 && errno != EINTR) {
+        fprintf(stderr, "Error polling input.\n");
+        exit(1);
+      }
+
+      if (n <= 0) {
+        continue;       // deadline or interrupt, check again
+      }
+    }
+
+    // traced as part of the sentence being assembled, which is the
+    // next one returned
+    TRACE_BEGIN(TRACE_TTY_READ, pending_channel(r, r->end), r->id + 1);
+    n  =  read(r->fd, r->buf + r->end, r->size - r->end);
+    TRACE_END(TRACE_TTY_READ, pending_channel(r, n > 0 ? r->end + n : r->end), r->id + 1);
+
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      fprintf(stderr, "Error reading input.\n");
+      exit(1);
+    }
+
+    if (n == 0) {
+      // end of file, return what is left
+      if (r->start < r->end) {
+        return  take_sentence(r, s, r->end - r->start);
+      }
+
+      return  0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &(r->read_time));
+    r->read_start  =  r->end;
+
+    if (r->start == r->end) {
+      r->partial_time  =  r->read_time;
+    }
+
+    r->end  +=  n;
+  }
+}
+
+
+void  tty_reader_close( tty_reader_t*  r )
+{
+  if (r->fp != NULL) {
+    close_tty_file(r->fp);
+  }
+  else if (r->fd != 0 && close(r->fd) != 0) {
+    fprintf(stderr, "Problem closing input file.\n");
+    exit(1);
+  }
+
+  free(r->buf);
+  free(r);
+}
+
+
+int  tty_read_mode( char*  name )
+{
+  if (strcmp(name, "stdio") == 0) {
+    return  TTY_READ_STDIO;
+  }
+  else if (strcmp(name, "block") == 0) {
+    return  TTY_READ_BLOCK;
+  }
+  else if (strcmp(name, "poll") == 0) {
+    return  TTY_READ_POLL;
+  }
+
+  return  -1;
+}
@@ -32,10 +32,36 @@
  * devices and data.
  */
 
+#include <stdint.h>
 #include <stdio.h>
+#include <time.h>
 
 #define CONFIG_GPIO 3  // default GPIO for configuration
 
+#define TTY_READ_STDIO   0      // read through stdio buffering (fgets)
+#define TTY_READ_BLOCK   1      // blocking read() on the raw fd
+#define TTY_READ_POLL    2      // poll() and read() on the raw fd
+
+#define TTY_BUF_SIZE     65536  // default size of the user space read buffer
+
+typedef struct {
+  int              fd;
+  FILE*            fp;            // only used for TTY_READ_STDIO
+  int              mode;
+  int              deadline_ms;   // flush partial sentences after this many ms, -1 is never
+
+  char*            buf;
+  int              size;
+  int              start;         // first byte not yet returned
+  int              scan;          // bytes before this have been checked for newline
+  int              end;           // byte after the last byte read
+  int              read_start;    // first byte of the last read
+  uint32_t         id;            // sentence number of the last sentence returned, for tracing
+
+  struct timespec  partial_time;  // arrival time of the oldest byte not yet returned
+  struct timespec  read_time;     // arrival time of the bytes from the last read
+} tty_reader_t;
+
 // Open a tty and exit if it fails. If name is NULL, stdin or stdout
 // is returned.
 FILE*  open_tty_file( char*  name,
@@ -46,4 +72,50 @@ FILE*  open_tty_file( char*  name,
 // nothing.
 void  close_tty_file( FILE*  fp );
 
+// Open a tty as a raw file descriptor and exit if it fails. Any baud
+// rate is accepted. vmin and vtime are set in the tty attributes for
+// input. If name is NULL, 0 or 1 is returned without changing
+// anything.
+int  open_tty_fd( char*  name,
+                  int    baud,
+                  int    is_output,
+                  int    vmin,
+                  int    vtime );
+
+// Set the baud rate and raw mode of an open tty. Any baud rate is
+// accepted. Returns 0 on success.
+int  set_tty_attributes( int  fd,
+                         int  baud,
+                         int  is_output,
+                         int  vmin,
+                         int  vtime );
+
+// Set the low latency flag of a serial device. Returns 0 on success
+// and -1 if the device does not support it.
+int  set_tty_low_latency( int  fd );
+
+// Make a reader for sentences on a file descriptor using one of the
+// TTY_READ_* modes. buf_size of 0 gives TTY_BUF_SIZE.
+tty_reader_t*  tty_reader_open( int  fd,
+                                int  mode,
+                                int  deadline_ms,
+                                int  buf_size );
+
+// Read a sentence into s, which has room for max chars including the
+// terminating zero. The result ends in a newline unless the sentence
+// was longer than max - 1 chars or the deadline for a partial
+// sentence expired (only in TTY_READ_POLL mode, at read returns in
+// TTY_READ_BLOCK mode). Returns the number of chars read, 0 on end
+// of file.
+int  tty_read_sentence( tty_reader_t*  r,
+                        char*          s,
+                        int            max );
+
+// Close the reader and its file descriptor unless it is stdin.
+void  tty_reader_close( tty_reader_t*  r );
+
+// Parse a read mode name ("stdio", "block" or "poll"). Returns -1 if
+// unknown.
+int  tty_read_mode( char*  name );
+
 #endif // __nmea_0183_utils_h__
@@ -0,0 +1,779 @@
+// Copyright 2020 Bjarne Knudsen
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+// conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+// conditions and the following disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+// endorse or promote products derived from this software without specific prior written
+// permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CHANNEL_CNT      8
+#define OUTPUT_CNT       8          // Maximum number of outputs
+#define TYPE_MAX         32         // Maximum number of sentence types to select
+#define TYPE_SLOTS       1024       // Size of the sentence type hash tables, a power of two
+#define TYPE_FULL        768        // More types than this are counted as other types
+#define CHUNK_SIZE       (8 << 20)  // Bytes per chunk, chunks end at a newline
+
+typedef struct {
+  char*     name;                   // NULL for stdout
+  FILE*     fp;
+} output_t;
+
+typedef struct {
+  uint64_t  key;                    // up to 7 address chars, 0 is an empty slot
+  uint64_t  count[CHANNEL_CNT];
+} type_count_t;
+
+typedef struct {
+  uint64_t      lines;
+  uint64_t      bad_channel;        // lines not starting with a channel number
+  uint64_t      selected[CHANNEL_CNT];
+  uint64_t      cs_ok[CHANNEL_CNT];
+  uint64_t      cs_bad[CHANNEL_CNT];
+  uint64_t      cs_none[CHANNEL_CNT];
+  uint64_t      other_types[CHANNEL_CNT];
+  int           type_cnt;
+  type_count_t  types[TYPE_SLOTS];
+} stats_t;
+
+typedef struct {
+  char*     buf;
+  size_t    len;
+  size_t    size;
+} buf_t;
+
+typedef struct {
+  char*     start;
+  char*     end;
+  int       done;
+  stats_t*  stats;
+  buf_t     out[OUTPUT_CNT];
+} chunk_t;
+
+// The chunks of one file. Workers take chunks in order, and the main
+// thread writes the results of each chunk in order. Workers stay
+// within window chunks of the writing to bound the memory used.
+
+typedef struct {
+  chunk_t*         chunks;
+  int              chunk_cnt;
+  int              next;            // next chunk to process
+  int              written;         // chunks written
+  int              window;
+
+  pthread_mutex_t  lock;
+  pthread_cond_t   cond;
+} job_t;
+
+static output_t  outputs[OUTPUT_CNT];
+static int       output_cnt  =  0;
+static int       channel_output[CHANNEL_CNT];  // output index of each channel, -1 is none
+
+static char*     types[TYPE_MAX];
+static int       type_cnt    =  0;
+
+static int       drop_bad    =  0;
+
+
+void  usage() {
+  fprintf(stderr, "\n");
+  fprintf(stderr, "usage: nmea_archive [options] <capture file> [<capture file>] ..\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Processes files with the output of nmea_0183_read, where each sentence starts\n");
+  fprintf(stderr, "with the channel number. The sentences can be split into files by channel\n");
+  fprintf(stderr, "like nmea_split does, and a summary of channels, checksums and sentence types\n");
+  fprintf(stderr, "is printed. The files are processed in chunks by several threads, but the\n");
+  fprintf(stderr, "output is always in the order of the input.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -h: print this help.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -o <channels> <file>: \"channels\" is any number of digits from 1 to 8\n");
+  fprintf(stderr, "        indicating input channels to be written to a file without the channel\n");
+  fprintf(stderr, "        number. \"-\" indicates stdout. This option can be used several times.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -t <types>: only use sentences of these types, separated by commas. A type\n");
+  fprintf(stderr, "        is the address field (GPGGA) or the sentence formatter (GGA).\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -b: leave out sentences with a wrong checksum.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -j <threads>: number of threads. Default is the number of CPUs.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "The summary goes to stdout, or stderr if stdout is used for sentences.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Example:\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  nmea_archive -o 123 nmea.txt -o 7 ais.txt -b capture1.txt capture2.txt\n");
+  fprintf(stderr, "\n");
+
+  exit(1);
+}
+
+
+static int  hex_value( char  c )
+{
+  if (c >= '0' && c <= '9') {
+    return  c - '0';
+  }
+  else if (c >= 'A' && c <= 'F') {
+    return  c - 'A' + 10;
+  }
+  else if (c >= 'a' && c <= 'f') {
+    return  c - 'a' + 10;
+  }
+
+  return  -1;
+}
+
+
+static int  type_selected( char*  addr,
+                           int    len )
+{
+  int  i;
+
+  if (type_cnt == 0) {
+    return  1;
+  }
+
+  for (i = 0; i < type_cnt; i++) {
+    int  n  =  strlen(types[i]);
+
+    if ((n == len && memcmp(types[i], addr, len) == 0) ||
+        (n == 3 && len == 5 && memcmp(types[i], addr + 2, 3) == 0)) {
+      return  1;
+    }
+  }
+
+  return  0;
+}
+
+
+// Find the entry of a sentence type, adding it if needed. Returns
+// NULL if the table is full.
+static type_count_t*  find_type( stats_t*  st,
+                                 uint64_t  key )
+{
+  uint32_t  h  =  (key * 0x9e3779b97f4a7c15ULL) >> 54;
+
+  while (1) {
+    type_count_t*  t  =  &(st->types[h & (TYPE_SLOTS - 1)]);
+
+    if (t->key == key) {
+      return  t;
+    }
+
+    if (t->key == 0) {
+      if (st->type_cnt >= TYPE_FULL) {
+        return  NULL;
+      }
+
+      t->key  =  key;
+      st->type_cnt++;
+
+      return  t;
+    }
+
+    h++;
+  }
+}
+
+
+static void  buf_add( buf_t*  b,
+                      char*   s,
+                      size_t  len )
+{
+  if (b->len + len > b->size) {
+    b->size  =  (b->len + len) * 2;
+    b->buf   =  realloc(b->buf, b->size);
+
+    if (b->buf == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(1);
+    }
+  }
+
+  memcpy(b->buf + b->len, s, len);
+  b->len  +=  len;
+}
+
+
+// Handle one line, which includes the newline if there is one.
+static void  process_line( chunk_t*  c,
+                           char*     s,
+                           size_t    len )
+{
+  stats_t*       st        =  c->stats;
+  char*          end       =  s + len;
+  char*          p;
+  char*          star      =  NULL;
+  uint8_t        sum       =  0;
+  uint64_t       key       =  0;
+  int            addr_len  =  0;
+  int            ch;
+  int            bad       =  0;
+  type_count_t*  t;
+
+  st->lines++;
+
+  if (s[0] < '1' || s[0] > '0' + CHANNEL_CNT) {
+    st->bad_channel++;
+    return;
+  }
+
+  ch  =  s[0] - '1';
+  s++;
+
+  // address field after $ or !
+  if (s < end && (s[0] == '$' || s[0] == '!')) {
+    for (p = s + 1; p < end && addr_len < 7 && *p != ',' && *p != '*' && *p >= ' '; p++) {
+      key  =  (key << 8) | (uint8_t) *p;
+      addr_len++;
+    }
+  }
+
+  if (!type_selected(s + 1, addr_len)) {
+    return;
+  }
+
+  // checksum of the chars between the start char and *
+  for (p = s + 1; p < end; p++) {
+    if (*p == '*') {
+      star  =  p;
+      break;
+    }
+
+    sum  ^=  *p;
+  }
+
+  if (star == NULL || star + 2 >= end) {
+    st->cs_none[ch]++;
+  }
+  else if (hex_value(star[1]) >= 0 && hex_value(star[2]) >= 0 &&
+           hex_value(star[1]) * 16 + hex_value(star[2]) == sum) {
+    st->cs_ok[ch]++;
+  }
+  else {
+    st->cs_bad[ch]++;
+    bad  =  1;
+  }
+
+  st->selected[ch]++;
+
+  t  =  addr_len > 0 ? find_type(st, key | ((uint64_t) addr_len << 56)) : NULL;
+
+  if (t != NULL) {
+    t->count[ch]++;
+  }
+  else {
+    st->other_types[ch]++;
+  }
+
+  if (channel_output[ch] >= 0 && !(bad && drop_bad)) {
+    buf_add(&(c->out[channel_output[ch]]), s, end - s);
+  }
+}
+
+
+static void  process_chunk( chunk_t*  c )
+{
+  char*  s  =  c->start;
+
+  c->stats  =  calloc(1, sizeof(stats_t));
+
+  if (c->stats == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+
+  while (s < c->end) {
+    char*  nl   =  memchr(s, '\n', c->end - s);
+    char*  end  =  nl == NULL ? c->end : nl + 1;
+
+    process_line(c, s, end - s);
+    s  =  end;
+  }
+}
+
+
+void*  worker( void*  arg )
+{
+  job_t*  job  =  (job_t*) arg;
+  int     i;
+
+  pthread_mutex_lock(&(job->lock));
+
+  while (1) {
+    while (job->next < job->chunk_cnt && job->next >= job->written + job->window) {
+      pthread_cond_wait(&(job->cond), &(job->lock));
+    }
+
+    if (job->next >= job->chunk_cnt) {
+      break;
+    }
+
+    i  =  job->next++;
+
+    pthread_mutex_unlock(&(job->lock));
+    process_chunk(&(job->chunks[i]));
+    pthread_mutex_lock(&(job->lock));
+
+    job->chunks[i].done  =  1;
+    pthread_cond_broadcast(&(job->cond));
+  }
+
+  pthread_mutex_unlock(&(job->lock));
+
+  return  NULL;
+}
+
+
+static void  merge_stats( stats_t*  total,
+                          stats_t*  st )
+{
+  int  i;
+  int  j;
+
+  total->lines        +=  st->lines;
+  total->bad_channel  +=  st->bad_channel;
+
+  for (i = 0; i < CHANNEL_CNT; i++) {
+    total->selected[i]     +=  st->selected[i];
+    total->cs_ok[i]        +=  st->cs_ok[i];
+    total->cs_bad[i]       +=  st->cs_bad[i];
+    total->cs_none[i]      +=  st->cs_none[i];
+    total->other_types[i]  +=  st->other_types[i];
+  }
+
+  for (i = 0; i < TYPE_SLOTS; i++) {
+    type_count_t*  t  =  &(st->types[i]);
+    type_count_t*  tt;
+
+    if (t->key == 0) {
+      continue;
+    }
+
+    tt  =  find_type(total, t->key);
+
+    for (j = 0; j < CHANNEL_CNT; j++) {
+      if (tt != NULL) {
+        tt->count[j]  +=  t->count[j];
+      }
+      else {
+        total->other_types[j]  +=  t->count[j];
+      }
+    }
+  }
+}
+
+
+static void  type_name( uint64_t  key,
+                        char*     name )
+{
+  int  len  =  key >> 56;
+  int  i;
+
+  for (i = 0; i < len; i++) {
+    name[len - 1 - i]  =  (key >> (8 * i)) & 0xff;
+  }
+
+  name[len]  =  '\0';
+}
+
+
+static int  compare_types( const void*  a,
+                           const void*  b )
+{
+  char  na[8];
+  char  nb[8];
+
+  type_name((*(type_count_t**) a)->key, na);
+  type_name((*(type_count_t**) b)->key, nb);
+
+  return  strcmp(na, nb);
+}
+
+
+static void  print_summary( FILE*     fp,
+                            stats_t*  total )
+{
+  type_count_t*  sorted[TYPE_SLOTS];
+  uint64_t       sum[4]  =  {0, 0, 0, 0};
+  char           name[8];
+  int            n  =  0;
+  int            i;
+  int            j;
+
+  fprintf(fp, "Lines: %llu, without channel number: %llu\n\n",
+          (unsigned long long) total->lines, (unsigned long long) total->bad_channel);
+
+  fprintf(fp, "Channel   Sentences  Checksum ok          Bad      Missing\n");
+
+  for (i = 0; i < CHANNEL_CNT; i++) {
+    if (total->selected[i] == 0) {
+      continue;
+    }
+
+    fprintf(fp, "%7d %11llu  %11llu  %11llu  %11llu\n", i + 1,
+            (unsigned long long) total->selected[i], (unsigned long long) total->cs_ok[i],
+            (unsigned long long) total->cs_bad[i], (unsigned long long) total->cs_none[i]);
+
+    sum[0]  +=  total->selected[i];
+    sum[1]  +=  total->cs_ok[i];
+    sum[2]  +=  total->cs_bad[i];
+    sum[3]  +=  total->cs_none[i];
+  }
+
+  fprintf(fp, "  Total %11llu  %11llu  %11llu  %11llu\n\n",
+          (unsigned long long) sum[0], (unsigned long long) sum[1],
+          (unsigned long long) sum[2], (unsigned long long) sum[3]);
+
+  for (i = 0; i < TYPE_SLOTS; i++) {
+    if (total->types[i].key != 0) {
+      sorted[n++]  =  &(total->types[i]);
+    }
+  }
+
+  qsort(sorted, n, sizeof(type_count_t*), compare_types);
+
+  fprintf(fp, "Type   ");
+
+  for (j = 0; j < CHANNEL_CNT; j++) {
+    if (total->selected[j] != 0) {
+      fprintf(fp, " %11d", j + 1);
+    }
+  }
+
+  fprintf(fp, "\n");
+
+  for (i = 0; i <= n; i++) {
+    uint64_t*  count  =  i < n ? sorted[i]->count : total->other_types;
+
+    if (i < n) {
+      type_name(sorted[i]->key, name);
+    }
+    else {
+      strcpy(name, "other");
+    }
+
+    fprintf(fp, "%-7s", name);
+
+    for (j = 0; j < CHANNEL_CNT; j++) {
+      if (total->selected[j] != 0) {
+        fprintf(fp, " %11llu", (unsigned long long) count[j]);
+      }
+    }
+
+    fprintf(fp, "\n");
+  }
+}
+
+
+// Process a file with the given number of threads and add to the
+// totals.
+static void  process_file( char*     name,
+                           int       thread_cnt,
+                           stats_t*  total )
+{
+  struct stat  stat_str;
+  pthread_t*   threads;
+  job_t        job;
+  char*        data;
+  char*        data_end;
+  char*        s;
+  int          fd;
+  int          i;
+  int          j;
+
+  fd  =  open(name, O_RDONLY);
+
+  if (fd < 0 || fstat(fd, &stat_str) != 0) {
+    fprintf(stderr, "Error opening input file: %s\n", name);
+    exit(1);
+  }
+
+  if (stat_str.st_size == 0) {
+    close(fd);
+    return;
+  }
+
+  data  =  mmap(NULL, stat_str.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "Error mapping input file: %s\n", name);
+    exit(1);
+  }
+
+  madvise(data, stat_str.st_size, MADV_SEQUENTIAL);
+
+  data_end  =  data + stat_str.st_size;
+
+  memset(&job, 0, sizeof(job));
+  job.chunks  =  calloc(stat_str.st_size / CHUNK_SIZE + 1, sizeof(chunk_t));
+  job.window  =  2 * thread_cnt;
+  threads     =  calloc(thread_cnt, sizeof(pthread_t));
+
+  if (job.chunks == NULL || threads == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+
+  // each chunk but the last is at least CHUNK_SIZE and ends after a
+  // newline
+  for (s = data; s < data_end; job.chunk_cnt++) {
+    char*  e  =  data_end;
+
+    if (data_end - s > CHUNK_SIZE) {
+      e  =  memchr(s + CHUNK_SIZE - 1, '\n', data_end - (s + CHUNK_SIZE - 1));
+      e  =  e == NULL ? data_end : e + 1;
+    }
+
+    job.chunks[job.chunk_cnt].start  =  s;
+    job.chunks[job.chunk_cnt].end    =  e;
+
+    s  =  e;
+  }
+
+  pthread_mutex_init(&(job.lock), NULL);
+  pthread_cond_init(&(job.cond), NULL);
+
+  for (i = 0; i < thread_cnt; i++) {
+    if (pthread_create(&(threads[i]), NULL, worker, &job) != 0) {
+      fprintf(stderr, "Error starting thread.\n");
+      exit(1);
+    }
+  }
+
+  // write the chunks in order as they are done
+  for (i = 0; i < job.chunk_cnt; i++) {
+    chunk_t*  c  =  &(job.chunks[i]);
+
+    pthread_mutex_lock(&(job.lock));
+
+    while (!c->done) {
+      pthread_cond_wait(&(job.cond), &(job.lock));
+    }
+
+    pthread_mutex_unlock(&(job.lock));
+
+    for (j = 0; j < output_cnt; j++) {
+      if (c->out[j].len > 0 &&
+          fwrite(c->out[j].buf, 1, c->out[j].len, outputs[j].fp) != c->out[j].len) {
+        fprintf(stderr, "Error writing output file: %s\n",
+                outputs[j].name == NULL ? "stdout" : outputs[j].name);
+        exit(1);
+      }
+
+      free(c->out[j].buf);
+    }
+
+    merge_stats(total, c->stats);
+    free(c->stats);
+
+    pthread_mutex_lock(&(job.lock));
+    job.written  =  i + 1;
+    pthread_cond_broadcast(&(job.cond));
+    pthread_mutex_unlock(&(job.lock));
+  }
+
+  for (i = 0; i < thread_cnt; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  pthread_mutex_destroy(&(job.lock));
+  pthread_cond_destroy(&(job.cond));
+
+  munmap(data, stat_str.st_size);
+  free(job.chunks);
+  free(threads);
+}
+
+
+int  main( int     argc,
+           char**  argv )
+{
+  stats_t*  total       =  calloc(1, sizeof(stats_t));
+  int       thread_cnt  =  sysconf(_SC_NPROCESSORS_ONLN);
+  int       use_stdout  =  0;
+  int       p           =  1;
+  int       i;
+  int       j;
+
+  if (total == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+
+  for (i = 0; i < CHANNEL_CNT; i++) {
+    channel_output[i]  =  -1;
+  }
+
+  while (p < argc && argv[p][0] == '-' && argv[p][1] != '\0') {
+    if (strcmp(argv[p], "-h") == 0) {
+      usage();
+    }
+    else if (strcmp(argv[p], "-o") == 0) {
+      output_t*  o  =  &(outputs[output_cnt]);
+
+      if (p + 1 >= argc) {
+        fprintf(stderr, "No output channels given.\n");
+        usage();
+      }
+
+      if (p + 2 >= argc) {
+        fprintf(stderr, "No output file given.\n");
+        usage();
+      }
+
+      if (output_cnt == OUTPUT_CNT) {
+        fprintf(stderr, "Too many outputs.\n");
+        usage();
+      }
+
+      o->name  =  strcmp(argv[p + 2], "-") == 0 ? NULL : argv[p + 2];
+
+      for (i = 0; i < output_cnt; i++) {
+        if (outputs[i].name == o->name ||
+            (o->name != NULL && outputs[i].name != NULL && strcmp(outputs[i].name, o->name) == 0)) {
+          fprintf(stderr, "Output %s given twice.\n", argv[p + 2]);
+          usage();
+        }
+      }
+
+      for (i = 0; argv[p + 1][i] != '\0'; i++) {
+        if (argv[p + 1][i] < '1' || argv[p + 1][i] > '0' + CHANNEL_CNT) {
+          fprintf(stderr, "Wrong channel number: %c\n", argv[p + 1][i]);
+          usage();
+        }
+
+        if (channel_output[argv[p + 1][i] - '1'] != -1) {
+          fprintf(stderr, "Output for channel %c given twice.\n", argv[p + 1][i]);
+          usage();
+        }
+
+        channel_output[argv[p + 1][i] - '1']  =  output_cnt;
+      }
+
+      output_cnt++;
+
+      p  +=  3;
+    }
+    else if (strcmp(argv[p], "-t") == 0) {
+      char*  t;
+
+      if (p + 1 >= argc) {
+        fprintf(stderr, "No types given.\n");
+        usage();
+      }
+
+      for (t = strtok(argv[p + 1], ","); t != NULL; t = strtok(NULL, ",")) {
+        if (type_cnt == TYPE_MAX) {
+          fprintf(stderr, "Too many types.\n");
+          usage();
+        }
+
+        if (strlen(t) > 7) {
+          fprintf(stderr, "Wrong type: %s\n", t);
+          usage();
+        }
+
+        types[type_cnt++]  =  t;
+      }
+
+      p  +=  2;
+    }
+    else if (strcmp(argv[p], "-b") == 0) {
+      drop_bad  =  1;
+
+      p++;
+    }
+    else if (strcmp(argv[p], "-j") == 0) {
+      if (p + 1 >= argc) {
+        fprintf(stderr, "No thread count given.\n");
+        usage();
+      }
+
+      if (sscanf(argv[p + 1], "%d%n", &thread_cnt, &i) < 1 || argv[p + 1][i] != '\0' ||
+          thread_cnt < 1) {
+        fprintf(stderr, "Wrong thread count\n");
+        usage();
+      }
+
+      p  +=  2;
+    }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", argv[p]);
+      usage();
+    }
+  }
+
+  if (p >= argc) {
+    fprintf(stderr, "No capture file given.\n");
+    usage();
+  }
+
+  if (thread_cnt < 1) {
+    thread_cnt  =  1;
+  }
+
+  for (i = 0; i < output_cnt; i++) {
+    if (outputs[i].name == NULL) {
+      outputs[i].fp  =  stdout;
+      use_stdout     =  1;
+    }
+    else {
+      outputs[i].fp  =  fopen(outputs[i].name, "w");
+
+      if (outputs[i].fp == NULL) {
+        fprintf(stderr, "Error opening output file: %s\n", outputs[i].name);
+        exit(1);
+      }
+    }
+  }
+
+  for (j = p; j < argc; j++) {
+    process_file(argv[j], thread_cnt, total);
+  }
+
+  for (i = 0; i < output_cnt; i++) {
+    if (fflush(outputs[i].fp) != 0 || (outputs[i].name != NULL && fclose(outputs[i].fp) != 0)) {
+      fprintf(stderr, "Error closing output file: %s\n",
+              outputs[i].name == NULL ? "stdout" : outputs[i].name);
+      exit(1);
+    }
+  }
+
+  print_summary(use_stdout ? stderr : stdout, total);
+
+  free(total);
+
+  return  0;
+}
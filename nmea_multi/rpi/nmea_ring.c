@@ -0,0 +1,367 @@
+// Copyright 2020 Bjarne Knudsen
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+// conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+// conditions and the following disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+// endorse or promote products derived from this software without specific prior written
+// permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "nmea_ring.h"
+
+#define NMEA_RING_MAGIC  0x4e4d5231  // "NMR1"
+
+// The counters are 32 bits, so they are lock free on all Raspberry
+// Pis. They wrap around, which is fine as long as the differences
+// are less than 2^31.
+
+struct nmea_ring_hdr_s {
+  uint32_t          magic;
+  uint32_t          slot_count;
+  uint32_t          slot_size;
+  _Atomic uint32_t  closed;       // set when the writer is done
+
+  _Atomic uint32_t  head;         // number of sentences written
+  _Atomic uint32_t  wake;         // futex word, changed on each write and on close
+  char              pad[40];      // keep the readers' counter on its own cache line
+
+  _Atomic uint32_t  waiters;      // number of readers waiting on the futex
+  char              pad2[60];
+};                                // 128 bytes, so the slots start on a cache line
+
+// seq is the sentence number + 1 when the slot is complete. While
+// the writer changes the slot, the top bit is flipped, which a
+// reader never looks for.
+
+struct nmea_ring_slot_s {
+  _Atomic uint32_t  seq;
+  uint8_t           channel;
+  uint8_t           len;
+  uint16_t          reserved;
+  uint64_t          time_ns;
+  char              s[NMEA_RING_TEXT_SIZE];
+};
+
+
+static char*  shm_name( char*  name )
+{
+  char*  s  =  malloc(strlen(name) + 2);
+
+  if (s == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+
+  if (name[0] == '/') {
+    strcpy(s, name);
+  }
+  else {
+    s[0]  =  '/';
+    strcpy(s + 1, name);
+  }
+
+  return  s;
+}
+
+
+static void  futex_wake( _Atomic uint32_t*  addr )
+{
+  syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+
+static void  futex_wait( _Atomic uint32_t*  addr,
+                         uint32_t           val,
+                         int                timeout_ms )
+{
+  struct timespec   t;
+  struct timespec*  tp  =  NULL;
+
+  if (timeout_ms >= 0) {
+    t.tv_sec   =  timeout_ms / 1000;
+    t.tv_nsec  =  (timeout_ms % 1000) * 1000000L;
+    tp         =  &t;
+  }
+
+  // returns at once if *addr is no longer val, so a wake between
+  // checking the ring and this call is not missed
+  syscall(SYS_futex, addr, FUTEX_WAIT, val, tp, NULL, 0);
+}
+
+
+nmea_ring_t*  nmea_ring_create( char*  name,
+                                int    slot_count )
+{
+  nmea_ring_t*  r  =  calloc(1, sizeof(nmea_ring_t));
+  int           fd;
+
+  if (r == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+
+  if (slot_count == 0) {
+    slot_count  =  NMEA_RING_SLOTS;
+  }
+
+  if (slot_count < 2 || (slot_count & (slot_count - 1)) != 0) {
+    fprintf(stderr, "Ring size must be a power of two: %d\n", slot_count);
+    exit(1);
+  }
+
+  r->name  =  shm_name(name);
+  r->mask  =  slot_count - 1;
+  r->size  =  sizeof(nmea_ring_hdr_t) + slot_count * sizeof(nmea_ring_slot_t);
+
+  // Remove the ring if it already exists, readers of the old one keep
+  // their mapping
+  if (shm_unlink(r->name) != 0 && errno != ENOENT) {
+    fprintf(stderr, "Error removing existing ring: %s\n", r->name);
+    exit(1);
+  }
+
+  fd  =  shm_open(r->name, O_RDWR | O_CREAT | O_EXCL, 0666);
+
+  if (fd < 0) {
+    fprintf(stderr, "Error creating ring: %s\n", r->name);
+    exit(1);
+  }
+
+  if (ftruncate(fd, r->size) != 0) {
+    fprintf(stderr, "Error setting size of ring: %s\n", r->name);
+    shm_unlink(r->name);
+    exit(1);
+  }
+
+  r->hdr  =  mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (r->hdr == MAP_FAILED) {
+    fprintf(stderr, "Error mapping ring: %s\n", r->name);
+    shm_unlink(r->name);
+    exit(1);
+  }
+
+  r->slots  =  (nmea_ring_slot_t*) (r->hdr + 1);
+
+  // the new object is all zeros
+  r->hdr->slot_count  =  slot_count;
+  r->hdr->slot_size   =  sizeof(nmea_ring_slot_t);
+  atomic_thread_fence(memory_order_release);
+  r->hdr->magic       =  NMEA_RING_MAGIC;
+
+  return  r;
+}
+
+
+void  nmea_ring_write( nmea_ring_t*  r,
+                       int           channel,
+                       char*         s,
+                       int           len,
+                       uint64_t      time_ns )
+{
+  uint32_t           n     =  atomic_load_explicit(&(r->hdr->head), memory_order_relaxed);
+  nmea_ring_slot_t*  slot  =  &(r->slots[n & r->mask]);
+
+  if (len > NMEA_RING_TEXT_SIZE - 1) {
+    len  =  NMEA_RING_TEXT_SIZE - 1;
+  }
+
+  atomic_store_explicit(&(slot->seq), (n + 1) ^ 0x80000000, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  slot->channel  =  channel;
+  slot->len      =  len;
+  slot->time_ns  =  time_ns;
+  memcpy(slot->s, s, len);
+  slot->s[len]   =  '\0';
+
+  atomic_store_explicit(&(slot->seq), n + 1, memory_order_release);
+  atomic_store(&(r->hdr->head), n + 1);
+  atomic_fetch_add(&(r->hdr->wake), 1);
+
+  if (atomic_load(&(r->hdr->waiters)) != 0) {
+    futex_wake(&(r->hdr->wake));
+  }
+}
+
+
+void  nmea_ring_destroy( nmea_ring_t*  r )
+{
+  atomic_store(&(r->hdr->closed), 1);
+  atomic_fetch_add(&(r->hdr->wake), 1);
+  futex_wake(&(r->hdr->wake));
+
+  if (munmap(r->hdr, r->size) != 0 || shm_unlink(r->name) != 0) {
+    fprintf(stderr, "Error removing ring: %s\n", r->name);
+  }
+
+  free(r->name);
+  free(r);
+}
+
+
+nmea_ring_t*  nmea_ring_open( char*  name,
+                              int    from_oldest )
+{
+  nmea_ring_t*      r  =  calloc(1, sizeof(nmea_ring_t));
+  char*             n  =  shm_name(name);
+  nmea_ring_hdr_t   hdr;
+  uint32_t          head;
+  int               fd;
+
+  if (r == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+
+  fd  =  shm_open(n, O_RDWR, 0);
+
+  if (fd < 0) {
+    fprintf(stderr, "Error opening ring: %s\n", n);
+    exit(1);
+  }
+
+  if (read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) || hdr.magic != NMEA_RING_MAGIC ||
+      hdr.slot_size != sizeof(nmea_ring_slot_t) || hdr.slot_count < 2 ||
+      (hdr.slot_count & (hdr.slot_count - 1)) != 0) {
+    fprintf(stderr, "Not a sentence ring: %s\n", n);
+    exit(1);
+  }
+
+  r->mask  =  hdr.slot_count - 1;
+  r->size  =  sizeof(nmea_ring_hdr_t) + hdr.slot_count * sizeof(nmea_ring_slot_t);
+  r->hdr   =  mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (r->hdr == MAP_FAILED) {
+    fprintf(stderr, "Error mapping ring: %s\n", n);
+    exit(1);
+  }
+
+  free(n);
+
+  r->slots   =  (nmea_ring_slot_t*) (r->hdr + 1);
+  head       =  atomic_load(&(r->hdr->head));
+  r->cursor  =  head;
+
+  if (from_oldest) {
+    r->cursor  =  head > r->mask ? head - r->mask : 0;
+  }
+
+  return  r;
+}
+
+
+int  nmea_ring_read( nmea_ring_t*      r,
+                     nmea_ring_rec_t*  rec,
+                     int               timeout_ms )
+{
+  nmea_ring_hdr_t*  hdr     =  r->hdr;
+  int               waited  =  0;
+
+  while (1) {
+    uint32_t  head  =  atomic_load(&(hdr->head));
+
+    if (head - r->cursor > r->mask + 1) {
+      // overrun, go to the oldest sentence that may still be there
+      r->lost    +=  head - (r->mask + 1) - r->cursor;
+      r->cursor   =  head - (r->mask + 1);
+    }
+
+    if (r->cursor != head) {
+      nmea_ring_slot_t*  slot  =  &(r->slots[r->cursor & r->mask]);
+      uint32_t           seq   =  r->cursor + 1;
+
+      if (atomic_load_explicit(&(slot->seq), memory_order_acquire) == seq) {
+        rec->time_ns  =  slot->time_ns;
+        rec->channel  =  slot->channel;
+        rec->len      =  slot->len;
+
+        if (rec->len > NMEA_RING_TEXT_SIZE - 1) {
+          rec->len  =  NMEA_RING_TEXT_SIZE - 1;
+        }
+
+        memcpy(rec->s, slot->s, rec->len);
+        rec->s[rec->len]  =  '\0';
+
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&(slot->seq), memory_order_relaxed) == seq) {
+          r->cursor++;
+          return  1;
+        }
+      }
+
+      // the writer has come around and is overwriting this slot
+      r->lost++;
+      r->cursor++;
+      continue;
+    }
+
+    if (atomic_load(&(hdr->closed))) {
+      return  -1;
+    }
+
+    if (waited || timeout_ms == 0) {
+      return  0;
+    }
+
+    // The writer changes the ring, then wake, then checks waiters. A
+    // reader counts itself as waiting, then reads wake, then checks
+    // the ring. Either the reader sees the change or the writer sees
+    // the reader and the futex sees the new wake.
+    atomic_fetch_add(&(hdr->waiters), 1);
+
+    uint32_t  wake  =  atomic_load(&(hdr->wake));
+
+    if (atomic_load(&(hdr->head)) == r->cursor && !atomic_load(&(hdr->closed))) {
+      futex_wait(&(hdr->wake), wake, timeout_ms);
+    }
+
+    atomic_fetch_sub(&(hdr->waiters), 1);
+
+    waited  =  1;
+  }
+}
+
+
+void  nmea_ring_close( nmea_ring_t*  r )
+{
+  if (munmap(r->hdr, r->size) != 0) {
+    fprintf(stderr, "Error closing ring.\n");
+  }
+
+  free(r);
+}
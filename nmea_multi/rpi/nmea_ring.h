@@ -0,0 +1,101 @@
+// Copyright 2020 Bjarne Knudsen
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+// conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+// conditions and the following disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+// endorse or promote products derived from this software without specific prior written
+// permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __nmea_ring_h__
+#define __nmea_ring_h__
+
+/*
+ * A ring of sentences in shared memory (/dev/shm) with one writer
+ * and any number of readers. The writer never waits for the readers.
+ * Each reader has its own cursor and finds out if the writer has
+ * overwritten sentences it did not read yet. Readers wait on a futex
+ * in the shared memory, so the writer only makes a system call when
+ * somebody is waiting.
+ */
+
+#include <stdint.h>
+
+#define NMEA_RING_SLOTS      4096  // default number of sentences kept, a power of two
+#define NMEA_RING_TEXT_SIZE  112   // room for the sentence text including the terminating zero
+
+typedef struct {
+  uint64_t  time_ns;                   // CLOCK_REALTIME when the sentence was read
+  int       channel;                   // input channel 1-8
+  int       len;                       // length of the text
+  char      s[NMEA_RING_TEXT_SIZE];    // the sentence without the channel number
+} nmea_ring_rec_t;
+
+typedef struct nmea_ring_hdr_s   nmea_ring_hdr_t;
+typedef struct nmea_ring_slot_s  nmea_ring_slot_t;
+
+typedef struct {
+  nmea_ring_hdr_t*   hdr;
+  nmea_ring_slot_t*  slots;
+  uint32_t           mask;        // slot count - 1
+  size_t             size;        // size of the mapping
+  char*              name;        // shared memory name, only kept by the writer
+
+  uint32_t           cursor;      // next sentence to read
+  uint32_t           lost;        // sentences overwritten before they were read
+} nmea_ring_t;
+
+// Create a ring with slot_count slots (a power of two, 0 gives
+// NMEA_RING_SLOTS) as the shared memory object name, replacing any
+// existing one. A missing leading "/" is added. Exits if it fails.
+nmea_ring_t*  nmea_ring_create( char*  name,
+                                int    slot_count );
+
+// Write a sentence to the ring. Text longer than
+// NMEA_RING_TEXT_SIZE - 1 chars is cut.
+void  nmea_ring_write( nmea_ring_t*  r,
+                       int           channel,
+                       char*         s,
+                       int           len,
+                       uint64_t      time_ns );
+
+// Tell the readers that no more sentences come, remove the shared
+// memory object and free the ring.
+void  nmea_ring_destroy( nmea_ring_t*  r );
+
+// Open an existing ring for reading. The first sentence read is the
+// next one written, or the oldest one kept if from_oldest is set.
+// Exits if it fails.
+nmea_ring_t*  nmea_ring_open( char*  name,
+                              int    from_oldest );
+
+// Read the next sentence into rec. Waits up to timeout_ms
+// milliseconds for it, -1 is forever. Returns 1 when a sentence is
+// read, 0 on timeout or signal and -1 when the writer has destroyed
+// the ring and all sentences have been read. Overwritten sentences
+// are skipped and counted in r->lost.
+int  nmea_ring_read( nmea_ring_t*      r,
+                     nmea_ring_rec_t*  rec,
+                     int               timeout_ms );
+
+// Unmap the ring and free it.
+void  nmea_ring_close( nmea_ring_t*  r );
+
+#endif // __nmea_ring_h__
@@ -0,0 +1,166 @@
+// Copyright 2020 Bjarne Knudsen
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+// conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+// conditions and the following disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+// endorse or promote products derived from this software without specific prior written
+// permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nmea_ring.h"
+
+
+void  usage() {
+  fprintf(stderr, "\n");
+  fprintf(stderr, "usage: nmea_ring_cat [options] <ring name>\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Prints sentences from a ring in shared memory written by nmea_split -s. Any\n");
+  fprintf(stderr, "number of these can read the same ring. Stops when nmea_split exits.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -h: print this help.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -c <channels>: only print sentences from these channels (digits 1-8).\n");
+  fprintf(stderr, "        Default is all channels in the ring.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -p: put the channel number in front of each sentence like nmea_0183_read\n");
+  fprintf(stderr, "        does, so the output can go to nmea_split.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -t: put the time the sentence was read in front of it in seconds.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -a: start with the oldest sentence kept in the ring instead of the next\n");
+  fprintf(stderr, "        one written.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Sentences lost because this program did not keep up are counted on stderr.\n");
+  fprintf(stderr, "\n");
+
+  exit(1);
+}
+
+
+int  main( int     argc,
+           char**  argv )
+{
+  char*            name         =  NULL;
+  int              mask         =  0xff;    // bit 0 is channel 1
+  int              prefix       =  0;
+  int              show_time    =  0;
+  int              from_oldest  =  0;
+  int              p            =  1;
+  uint32_t         lost         =  0;
+  nmea_ring_t*     ring;
+  nmea_ring_rec_t  rec;
+  int              i;
+  int              n;
+
+  while (p < argc) {
+    if (strcmp(argv[p], "-h") == 0) {
+      usage();
+    }
+    else if (strcmp(argv[p], "-c") == 0) {
+      if (p + 1 >= argc) {
+        fprintf(stderr, "No channels given.\n");
+        usage();
+      }
+
+      mask  =  0;
+
+      for (i = 0; argv[p + 1][i] != '\0'; i++) {
+        if (argv[p + 1][i] < '1' || argv[p + 1][i] > '8') {
+          fprintf(stderr, "Wrong channel number: %c\n", argv[p + 1][i]);
+          usage();
+        }
+
+        mask  |=  1 << (argv[p + 1][i] - '1');
+      }
+
+      p  +=  2;
+    }
+    else if (strcmp(argv[p], "-p") == 0) {
+      prefix  =  1;
+      p++;
+    }
+    else if (strcmp(argv[p], "-t") == 0) {
+      show_time  =  1;
+      p++;
+    }
+    else if (strcmp(argv[p], "-a") == 0) {
+      from_oldest  =  1;
+      p++;
+    }
+    else if (argv[p][0] != '-' && name == NULL) {
+      name  =  argv[p];
+      p++;
+    }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", argv[p]);
+      usage();
+    }
+  }
+
+  if (name == NULL) {
+    fprintf(stderr, "No ring name given.\n");
+    usage();
+  }
+
+  ring  =  nmea_ring_open(name, from_oldest);
+
+  while (1) {
+    n  =  nmea_ring_read(ring, &rec, 0);
+
+    if (n == 0) {
+      // nothing waiting, flush before sleeping
+      fflush(stdout);
+      n  =  nmea_ring_read(ring, &rec, -1);
+    }
+
+    if (ring->lost != lost) {
+      fprintf(stderr, "Lost %u sentences.\n", ring->lost - lost);
+      lost  =  ring->lost;
+    }
+
+    if (n < 0) {
+      break;
+    }
+
+    if (n == 0 || (mask & (1 << (rec.channel - 1))) == 0) {
+      continue;
+    }
+
+    if (show_time) {
+      printf("%llu.%06llu ", (unsigned long long) (rec.time_ns / 1000000000ULL),
+             (unsigned long long) (rec.time_ns % 1000000000ULL / 1000));
+    }
+
+    if (prefix) {
+      putchar('0' + rec.channel);
+    }
+
+    fputs(rec.s, stdout);
+  }
+
+  fflush(stdout);
+  nmea_ring_close(ring);
+
+  return  0;
+}
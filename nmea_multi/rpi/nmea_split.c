@@ -31,24 +31,53 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "nmea_ring.h"
+#include "nmea_trace.h"
 
 #define MAX_LINE         1024
 
-#define FIFO_IDX_NO      -1
-#define FIFO_IDX_STDOUT  -2
 #define FIFO_CNT          8   // Maximum number of fifos
 
+#define RETRY_MS        100   // Time between tries to open new fifos without a reader
+
 typedef struct {
   FILE*  fp;
 
-  char*  name;
+  char*  name;                // NULL for stdout
+  int    created;             // the fifo file was made by open_fifos
 } fifo_t;
 
+// The routing table. Channels going to the same fifo share the
+// fifo_t.
+
+typedef struct {
+  fifo_t*  fifos[FIFO_CNT];   // output of each channel, NULL if ignored
+} route_t;
+
+static fifo_t             stdout_fifo;
+
+static char*              config_name  =  NULL;
+
+// A new routing table from the reload thread that the main loop has
+// not taken yet.
+static _Atomic(route_t*)  new_route    =  NULL;
+
+// Set by the main loop before it sends SIGHUP to stop the reload
+// thread.
+static atomic_int         stop_reload  =  0;
+
 
 void  usage() {
   fprintf(stderr, "\n");
   fprintf(stderr, "usage: nmea_split [options] -f <channels> <fifo file>\n");
   fprintf(stderr, "                           [-f <channels> <fifo file>] ..\n");
+  fprintf(stderr, "                           [-s <channels> <ring name>]\n");
+  fprintf(stderr, "       nmea_split [options] -c <config file> [-s <channels> <ring name>]\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "Takes input from stdin (typically the output of nmea_0183_read) and splits it\n");
   fprintf(stderr, "into different newly created fifo files and/or stdout according to the NMEA\n");
@@ -64,6 +93,19 @@ void  usage() {
   fprintf(stderr, "        file name for a new fifo to be created. \"-\" indicates stdout. This\n");
   fprintf(stderr, "        option can be used several times.\n");
   fprintf(stderr, "\n");
+  fprintf(stderr, "  -c <config file>: read the channels and fifos from a file instead of -f\n");
+  fprintf(stderr, "        options. Each line is \"<channels> <fifo file>\" like the -f option,\n");
+  fprintf(stderr, "        and lines starting with # are comments. On a HUP signal, the file is\n");
+  fprintf(stderr, "        read again and the new routing is used without stopping. Fifos still\n");
+  fprintf(stderr, "        in the file stay open, new ones are created and the rest are removed.\n");
+  fprintf(stderr, "        The old routing is kept until the new fifos have readers, and if the\n");
+  fprintf(stderr, "        file has an error.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -s <channels> <ring name>: also write sentences from \"channels\" to a ring in\n");
+  fprintf(stderr, "        shared memory (/dev/shm/<ring name>) along with channel number and\n");
+  fprintf(stderr, "        time. Any number of readers such as nmea_ring_cat can read the ring.\n");
+  fprintf(stderr, "        The channels may also go to a fifo or stdout.\n");
+  fprintf(stderr, "\n");
   fprintf(stderr, "Example:\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "  nmea_split -f 123 /tmp/nmea -f 456 - -f 7 /tmp/navtex\n");
@@ -77,29 +119,392 @@ void  usage() {
 }
 
 
-int  main( int     argc,
-           char**  argv )
+// Find the fifo with the given name in a routing table, NULL is
+// stdout. Returns NULL if it is not there.
+static fifo_t*  find_fifo( route_t*  r,
+                           char*     name )
+{
+  int  i;
+
+  for (i = 0; i < FIFO_CNT; i++) {
+    fifo_t*  f  =  r->fifos[i];
+
+    if (f != NULL && (f->name == name || (f->name != NULL && name != NULL &&
+                                           strcmp(f->name, name) == 0))) {
+      return  f;
+    }
+  }
+
+  return  NULL;
+}
+
+
+// Check if a fifo is used by a routing table.
+static int  has_fifo( route_t*  r,
+                      fifo_t*   f )
+{
+  int  i;
+
+  for (i = 0; i < FIFO_CNT; i++) {
+    if (r->fifos[i] == f) {
+      return  1;
+    }
+  }
+
+  return  0;
+}
+
+
+// Add channels going to the named fifo ("-" is stdout) to a routing
+// table. A fifo with the same name in old is reused, so it stays
+// open. Returns -1 after printing a message on error.
+static int  add_route( route_t*  r,
+                       char*     channels,
+                       char*     name,
+                       route_t*  old )
+{
+  fifo_t*  f;
+  int      i;
+
+  if (strcmp(name, "-") == 0) {
+    name  =  NULL;
+  }
+
+  if (find_fifo(r, name) != NULL) {
+    if (name == NULL) {
+      fprintf(stderr, "stdout given as output twice.\n");
+    }
+    else {
+      fprintf(stderr, "Fifo name %s given twice.\n", name);
+    }
+
+    return  -1;
+  }
+
+  for (i = 0; channels[i] != '\0'; i++) {
+    if (channels[i] < '1' || channels[i] > '0' + FIFO_CNT) {
+      fprintf(stderr, "Wrong channel number: %c\n", channels[i]);
+      return  -1;
+    }
+
+    if (r->fifos[channels[i] - '1'] != NULL) {
+      fprintf(stderr, "Fifo for channel %c given twice.\n", channels[i]);
+      return  -1;
+    }
+  }
+
+  if (name == NULL) {
+    f  =  &stdout_fifo;
+  }
+  else if (old != NULL && (f = find_fifo(old, name)) != NULL) {
+    // keep the open fifo
+  }
+  else {
+    f  =  calloc(1, sizeof(fifo_t));
+
+    if (f == NULL || (f->name = strdup(name)) == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(1);
+    }
+  }
+
+  for (i = 0; channels[i] != '\0'; i++) {
+    r->fifos[channels[i] - '1']  =  f;
+  }
+
+  return  0;
+}
+
+
+static void  close_fifos( route_t*  r,
+                          route_t*  keep );
+
+
+// Read a routing table from the config file. Returns NULL after
+// printing a message on error.
+static route_t*  read_config( char*     name,
+                              route_t*  old )
 {
-  FILE*       in_fp       =  stdin;
-  int         fifo_found  =  0;
-  int         p           =  1;
-  int         fifo_count  =  0;
-  fifo_t      fifos[FIFO_CNT];
-  int         fifo_indices[FIFO_CNT];
-  char        s[MAX_LINE];
-  int         i;
+  route_t*  r   =  calloc(1, sizeof(route_t));
+  FILE*     fp  =  fopen(name, "r");
+  char      s[MAX_LINE];
+  char      channels[MAX_LINE];
+  char      fifo[MAX_LINE];
+  char      extra[2];
+  int       line  =  0;
+
+  if (r == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+
+  if (fp == NULL) {
+    fprintf(stderr, "Error opening config file: %s\n", name);
+    free(r);
+    return  NULL;
+  }
+
+  while (fgets(s, MAX_LINE, fp) != NULL) {
+    int  n  =  sscanf(s, "%s %s %1s", channels, fifo, extra);
+
+    line++;
+
+    if (n <= 0 || channels[0] == '#') {
+      continue;
+    }
+
+    if (n != 2 || add_route(r, channels, fifo, old) != 0) {
+      fprintf(stderr, "Error in config file %s line %d: %s", name, line, s);
+      fclose(fp);
+      close_fifos(r, old);
+      free(r);
+      return  NULL;
+    }
+  }
+
+  fclose(fp);
+
+  return  r;
+}
+
+
+// Create and open the fifos in a routing table that are not open
+// yet. Without O_NONBLOCK in flags, opening waits for a reader. With
+// it, fifos without a reader are left unopened and 1 is returned, so
+// this can be called again later. Returns -1 after printing a message
+// on error.
+static int  open_fifos( route_t*  r,
+                        int       flags )
+{
+  int  waiting  =  0;
+  int  i;
 
   for (i = 0; i < FIFO_CNT; i++) {
-    fifo_indices[i]  =  FIFO_IDX_NO;
+    fifo_t*      f  =  r->fifos[i];
+    struct stat  stat_str;
+    int          fd;
+
+    if (f == NULL || f->name == NULL || f->fp != NULL) {
+      // not used, stdout or already open
+      continue;
+    }
+
+    if (!f->created) {
+      // not made by an earlier call that found no reader
+      if (stat(f->name, &stat_str) != 0) {
+        if (errno != ENOENT) {
+          fprintf(stderr, "Error checking fifo file: %s\n", f->name);
+          return  -1;
+        }
+      }
+      else if ((stat_str.st_mode & S_IFIFO) != 0) {
+        // Remove fifo if it already exists
+        if (unlink(f->name) != 0) {
+          fprintf(stderr, "Error removing existing fifo file: %s\n", f->name);
+          return  -1;
+        }
+      }
+
+      if (mkfifo(f->name, 0666) != 0) {
+        fprintf(stderr, "Error creating fifo file: %s\n", f->name);
+        return  -1;
+      }
+
+      f->created  =  1;
+    }
+
+    fd  =  open(f->name, O_WRONLY | flags);
+
+    if (fd < 0 && errno == ENXIO && (flags & O_NONBLOCK) != 0) {
+      // no reader yet
+      waiting  =  1;
+      continue;
+    }
+
+    if (fd < 0) {
+      fprintf(stderr, "Error opening fifo: %s\n", f->name);
+      return  -1;
+    }
+
+    if ((flags & O_NONBLOCK) != 0 && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK) != 0) {
+      // writes block like for the other fifos
+      fprintf(stderr, "Error opening fifo: %s\n", f->name);
+      close(fd);
+      return  -1;
+    }
+
+    f->fp  =  fdopen(fd, "w");
+
+    if (f->fp == NULL) {
+      fprintf(stderr, "Error opening fifo: %s\n", f->name);
+      close(fd);
+      return  -1;
+    }
   }
 
+  return  waiting;
+}
+
+
+// Close and remove the fifos in a routing table that are not used by
+// keep (which may be NULL) and free them. The table itself is not
+// freed.
+static void  close_fifos( route_t*  r,
+                          route_t*  keep )
+{
+  int  i;
+  int  j;
+
+  for (i = 0; i < FIFO_CNT; i++) {
+    fifo_t*  f  =  r->fifos[i];
+
+    if (f == NULL || f == &stdout_fifo || (keep != NULL && has_fifo(keep, f))) {
+      continue;
+    }
+
+    for (j = i + 1; j < FIFO_CNT; j++) {
+      if (r->fifos[j] == f) {
+        r->fifos[j]  =  NULL;
+      }
+    }
+
+    if ((f->fp != NULL && fclose(f->fp) != 0) || (f->created && unlink(f->name) != 0)) {
+      fprintf(stderr, "Error closing fifo: %s\n", f->name);
+    }
+
+    r->fifos[i]  =  NULL;
+
+    free(f->name);
+    free(f);
+  }
+}
+
+
+// Thread reloading the config file on SIGHUP. The new table is
+// handed to the main loop through new_route, so the main loop never
+// waits for this thread. The old table is closed here once the main
+// loop has taken the new one and so is done with the old. New fifos
+// are opened without waiting for readers. Until they all have one,
+// the new table is held back and opening is tried again every
+// RETRY_MS, and another SIGHUP starts over with the file as it is
+// then. The thread is stopped by setting stop_reload and sending
+// SIGHUP. It is never cancelled, so it does not stop halfway through
+// opening or closing fifos.
+void*  reload_routes( void*  arg )
+{
+  route_t*         cur    =  (route_t*) arg;
+  route_t*         r      =  NULL;    // new table waiting for readers
+  struct timespec  retry  =  {0, RETRY_MS * 1000000L};
+  sigset_t         set;
+  int              sig;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGHUP);
+
+  while (1) {
+    int  got_signal;
+    int  res;
+
+    if (r == NULL) {
+      got_signal  =  (sigwait(&set, &sig) == 0);
+    }
+    else {
+      got_signal  =  (sigtimedwait(&set, NULL, &retry) == SIGHUP);
+    }
+
+    if (got_signal) {
+      if (r != NULL) {
+        // start over with the file as it is now
+        close_fifos(r, cur);
+        free(r);
+        r  =  NULL;
+      }
+
+      if (atomic_load(&stop_reload)) {
+        break;
+      }
+
+      r  =  read_config(config_name, cur);
+
+      if (r == NULL) {
+        fprintf(stderr, "Keeping the old routing.\n");
+        continue;
+      }
+    }
+    else if (r == NULL) {
+      continue;
+    }
+
+    res  =  open_fifos(r, O_NONBLOCK);
+
+    if (res < 0) {
+      fprintf(stderr, "Keeping the old routing.\n");
+      close_fifos(r, cur);
+      free(r);
+      r  =  NULL;
+      continue;
+    }
+
+    if (res > 0) {
+      if (got_signal) {
+        fprintf(stderr, "New fifos have no reader yet, keeping the old routing until they do.\n");
+      }
+
+      continue;
+    }
+
+    atomic_store(&new_route, r);
+
+    // taken at the next input line
+    while (atomic_load(&new_route) != NULL && !atomic_load(&stop_reload)) {
+      usleep(10000);
+    }
+
+    if (atomic_load(&new_route) != NULL) {
+      // stopping, the main loop closes the new table
+      break;
+    }
+
+    close_fifos(cur, r);
+    free(cur);
+    cur  =  r;
+    r    =  NULL;
+  }
+
+  return  NULL;
+}
+
+
+int  main( int     argc,
+           char**  argv )
+{
+  FILE*         in_fp       =  stdin;
+  int           fifo_found  =  0;
+  int           f_found     =  0;
+  int           p           =  1;
+  route_t*      route;
+  char          s[MAX_LINE];
+  char*         ring_name   =  NULL;
+  int           ring_mask   =  0;     // bit 0 is channel 1
+  nmea_ring_t*  ring        =  NULL;
+  pthread_t     thread;
+  uint32_t      id          =  0;     // sentence number for tracing
+  int           i;
+
+  route  =  calloc(1, sizeof(route_t));
+
+  if (route == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+
+  stdout_fifo.fp  =  stdout;
+
   while (p < argc) {
     if (strcmp(argv[p], "-h") == 0) {
       usage();
     }
     else if (strcmp(argv[p], "-f") == 0) {
-      int  idx  =  FIFO_IDX_STDOUT;
-
       if (p + 1 >= argc) {
         fprintf(stderr, "No fifo channels given.\n");
         usage();
@@ -110,16 +515,56 @@ int  main( int     argc,
         usage();
       }
 
-      if (strcmp(argv[p + 2], "-") != 0) {
-        idx = fifo_count;
+      if (config_name != NULL) {
+        fprintf(stderr, "Both -c and -f options given.\n");
+        usage();
       }
-      else {
-        for (i = 0; i < FIFO_CNT; i++) {
-          if (fifo_indices[i] == FIFO_IDX_STDOUT) {
-            fprintf(stderr, "stdout given as output twice.\n");
-            usage();
-          }
-        }
+
+      if (add_route(route, argv[p + 1], argv[p + 2], NULL) != 0) {
+        usage();
+      }
+
+      p  +=  3;
+
+      fifo_found  =  1;
+      f_found     =  1;
+    }
+    else if (strcmp(argv[p], "-c") == 0) {
+      if (p + 1 >= argc) {
+        fprintf(stderr, "No config file given.\n");
+        usage();
+      }
+
+      if (config_name != NULL) {
+        fprintf(stderr, "Config file given twice.\n");
+        usage();
+      }
+
+      if (f_found) {
+        fprintf(stderr, "Both -c and -f options given.\n");
+        usage();
+      }
+
+      config_name  =  argv[p + 1];
+
+      p  +=  2;
+
+      fifo_found  =  1;
+    }
+    else if (strcmp(argv[p], "-s") == 0) {
+      if (p + 1 >= argc) {
+        fprintf(stderr, "No ring channels given.\n");
+        usage();
+      }
+
+      if (p + 2 >= argc) {
+        fprintf(stderr, "No ring name given.\n");
+        usage();
+      }
+
+      if (ring_name != NULL) {
+        fprintf(stderr, "Ring given twice.\n");
+        usage();
       }
 
       for (i = 0; argv[p + 1][i] != '\0'; i++) {
@@ -128,25 +573,10 @@ int  main( int     argc,
           usage();
         }
 
-        if (fifo_indices[argv[p + 1][i] - '1'] != FIFO_IDX_NO) {
-          fprintf(stderr, "Fifo for channel %c given twice.\n", argv[p + 1][i]);
-          usage();
-        }
-        fifo_indices[argv[p + 1][i] - '1'] = idx;
+        ring_mask  |=  1 << (argv[p + 1][i] - '1');
       }
 
-      if (idx != FIFO_IDX_STDOUT) {
-        for (i = 0; i < fifo_count; i++) {
-          if (strcmp(fifos[i].name, argv[p + 2]) == 0) {
-            fprintf(stderr, "Fifo name %s given twice.\n", argv[p + 2]);
-            usage();
-          }
-        }
-
-        fifos[fifo_count].name  =  argv[p + 2];
-
-        fifo_count++;
-      }
+      ring_name  =  argv[p + 2];
 
       p  +=  3;
 
@@ -159,97 +589,103 @@ int  main( int     argc,
   }
 
   if (!fifo_found) {
-    fprintf(stderr, "No -f option found.\n");
+    fprintf(stderr, "No -f, -c or -s option found.\n");
     usage();
   }
 
+  if (config_name != NULL) {
+    free(route);
+    route  =  read_config(config_name, NULL);
 
-  for (i = 0; i < fifo_count; i++) {
-    char*  name  =  fifos[i].name;
-
-    if (name == NULL) {
-      // stdout
-      continue;
+    if (route == NULL) {
+      exit(1);
     }
+  }
 
-    struct stat  stat_str;
+  if (open_fifos(route, 0) != 0) {
+    close_fifos(route, NULL);
+    exit(1);
+  }
 
-    if (stat(name, &stat_str) != 0) {
-      if (errno != ENOENT) {
-        fprintf(stderr, "Error checking fifo file: %s\n", name);
-        exit(1);
-      }
-    }
-    else if ((stat_str.st_mode & S_IFIFO) != 0) {
-      // Remove fifo if it already exists
-      if (unlink(name) != 0) {
-        fprintf(stderr, "Error removing existing fifo file: %s\n", name);
-        exit(1);
-      }
-    }
+  if (config_name != NULL) {
+    sigset_t  set;
+
+    // Only the reload thread gets SIGHUP
+    sigemptyset(&set);
+    sigaddset(&set, SIGHUP);
 
-    if (mkfifo(name, 0666) != 0) {
-      fprintf(stderr, "Error creating fifo file: %s\n", name);
+    if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0 ||
+        pthread_create(&thread, NULL, reload_routes, route) != 0) {
+      fprintf(stderr, "Error starting reload thread.\n");
+      close_fifos(route, NULL);
       exit(1);
     }
   }
 
-  for (i = 0; i < fifo_count; i++) {
-    char*  name  =  fifos[i].name;
-    int    fd;
-
-    if (name == NULL) {
-      // stdout
-      continue;
-    }
+  if (ring_name != NULL) {
+    ring  =  nmea_ring_create(ring_name, 0);
+  }
 
-    fd  =  open(name, O_WRONLY);
+  TRACE_INIT("nmea_split");
 
-    if (fd < 0) {
-      fprintf(stderr, "Error opening fifo: %s\n", name);
-      unlink(name);
-      exit(1);
-    }
+  TRACE_BEGIN(TRACE_PIPE_READ, 0, id + 1);
 
-    fifos[i].fp  =  fdopen(fd, "w");
+  while (fgets(s, MAX_LINE, in_fp) != NULL) {
+    id++;
+    TRACE_END(TRACE_PIPE_READ, s[0] >= '1' && s[0] <= '8' ? s[0] - '0' : 0, id);
 
-    if (fifos[i].fp == NULL) {
-      fprintf(stderr, "Error opening fifo: %s\n", name);
-      unlink(name);
-      exit(1);
+    // A plain load on each line, the exchange only after a reload
+    if (atomic_load_explicit(&new_route, memory_order_relaxed) != NULL) {
+      route  =  atomic_exchange(&new_route, NULL);
     }
-  }
 
-  while (fgets(s, MAX_LINE, in_fp) != NULL) {
     if (s[0] < '1' || s[0] > '0' + FIFO_CNT) {
       fprintf(stderr, "Wrong channel number in input: %s", s);
     }
     else {
-      int  idx  =  fifo_indices[s[0] - '1'];
+      fifo_t*  f  =  route->fifos[s[0] - '1'];
+
+      if ((ring_mask & (1 << (s[0] - '1'))) != 0) {
+        struct timespec  t;
 
-      if (idx == FIFO_IDX_STDOUT) {
-        fputs(s + 1, stdout);
-        fflush(stdout);
+        TRACE_BEGIN(TRACE_RING_WRITE, s[0] - '0', id);
+        clock_gettime(CLOCK_REALTIME, &t);
+        nmea_ring_write(ring, s[0] - '0', s + 1, strlen(s + 1),
+                        t.tv_sec * 1000000000ULL + t.tv_nsec);
+        TRACE_END(TRACE_RING_WRITE, s[0] - '0', id);
       }
-      else if (idx != FIFO_IDX_NO) {
-        fputs(s + 1, fifos[idx].fp);
-        fflush(fifos[idx].fp);
+
+      if (f != NULL) {
+        TRACE_BEGIN(TRACE_FIFO_WRITE, s[0] - '0', id);
+        fputs(s + 1, f->fp);
+        fflush(f->fp);
+        TRACE_END(TRACE_FIFO_WRITE, s[0] - '0', id);
       }
     }
+
+    TRACE_BEGIN(TRACE_PIPE_READ, 0, id + 1);
   }
 
-  for (i = 0; i < fifo_count; i++) {
-    char*  name  =  fifos[i].name;
+  if (ring != NULL) {
+    nmea_ring_destroy(ring);
+  }
 
-    if (name == NULL) {
-      // stdout
-      continue;
-    }
+  if (config_name != NULL) {
+    route_t*  r;
 
-    if (fclose(fifos[i].fp) != 0 || unlink(name) != 0) {
-      fprintf(stderr, "Error closing fifo: %s\n", fifos[i].name);
+    // Stop the reload thread so the tables are only used from here
+    atomic_store(&stop_reload, 1);
+    pthread_kill(thread, SIGHUP);
+    pthread_join(thread, NULL);
+
+    r  =  atomic_exchange(&new_route, NULL);
+
+    if (r != NULL) {
+      close_fifos(r, route);
     }
   }
 
+  close_fifos(route, NULL);
+
   return  0;
 }
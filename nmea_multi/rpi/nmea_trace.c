@@ -0,0 +1,176 @@
+// Copyright 2020 Bjarne Knudsen
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+// conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+// conditions and the following disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+// endorse or promote products derived from this software without specific prior written
+// permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifdef NMEA_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+
+#include "nmea_trace.h"
+
+__thread trace_ring_t*  trace_ring  =  NULL;
+
+static trace_ring_t*    rings[TRACE_THREADS];
+static _Atomic int      ring_cnt    =  0;
+
+static char             trace_name[16];
+static char             dump_name[64];
+
+
+trace_ring_t*  trace_new_ring( void )
+{
+  trace_ring_t*  r  =  calloc(1, sizeof(trace_ring_t));
+  int            i;
+
+  if (r == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(1);
+  }
+
+  r->tid  =  syscall(SYS_gettid);
+
+  // A thread over the limit is traced but not dumped
+  i  =  atomic_fetch_add(&ring_cnt, 1);
+
+  if (i < TRACE_THREADS) {
+    rings[i]  =  r;
+  }
+
+  trace_ring  =  r;
+
+  return  r;
+}
+
+
+// Only async-signal-safe calls, since this is also the signal
+// handler. Threads keep writing events during the dump, so the
+// oldest events of a busy thread may be newer than expected.
+void  trace_dump( void )
+{
+  trace_file_hdr_t  hdr;
+  int               cnt  =  atomic_load(&ring_cnt);
+  int               fd;
+  int               i;
+
+  if (dump_name[0] == '\0') {
+    return;
+  }
+
+  fd  =  open(dump_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+
+  if (fd < 0) {
+    return;
+  }
+
+  if (cnt > TRACE_THREADS) {
+    cnt  =  TRACE_THREADS;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic    =  TRACE_MAGIC;
+  hdr.pid      =  getpid();
+  hdr.threads  =  0;
+  memcpy(hdr.name, trace_name, sizeof(hdr.name));
+
+  for (i = 0; i < cnt; i++) {
+    if (rings[i] != NULL) {
+      hdr.threads++;
+    }
+  }
+
+  if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+    close(fd);
+    return;
+  }
+
+  for (i = 0; i < cnt; i++) {
+    trace_ring_t*       r  =  rings[i];
+    trace_thread_hdr_t  th;
+    uint32_t            n;
+    uint32_t            start;
+
+    if (r == NULL) {
+      continue;
+    }
+
+    n         =  r->n;
+    th.tid    =  r->tid;
+    th.count  =  n < TRACE_EVENTS ? n : TRACE_EVENTS;
+    start     =  (n - th.count) & (TRACE_EVENTS - 1);
+
+    if (write(fd, &th, sizeof(th)) != sizeof(th)) {
+      break;
+    }
+
+    // from start to the end of the ring, then the beginning
+    if (start + th.count > TRACE_EVENTS) {
+      if (write(fd, r->ev + start, (TRACE_EVENTS - start) * sizeof(trace_event_t)) < 0 ||
+          write(fd, r->ev, (start + th.count - TRACE_EVENTS) * sizeof(trace_event_t)) < 0) {
+        break;
+      }
+    }
+    else if (write(fd, r->ev + start, th.count * sizeof(trace_event_t)) < 0) {
+      break;
+    }
+  }
+
+  close(fd);
+}
+
+
+static void  trace_signal( int  sig )
+{
+  trace_dump();
+}
+
+
+void  trace_init( char*  name )
+{
+  struct sigaction  sa;
+
+  strncpy(trace_name, name, sizeof(trace_name) - 1);
+  snprintf(dump_name, sizeof(dump_name), "/tmp/%s.%d.trace", trace_name, (int) getpid());
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler  =  trace_signal;
+  sa.sa_flags    =  SA_RESTART;
+  sigemptyset(&(sa.sa_mask));
+
+  if (sigaction(SIGUSR2, &sa, NULL) != 0) {
+    fprintf(stderr, "Error setting up trace signal.\n");
+    exit(1);
+  }
+
+  atexit(trace_dump);
+}
+
+#endif // NMEA_TRACE
@@ -0,0 +1,148 @@
+// Copyright 2020 Bjarne Knudsen
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+// conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+// conditions and the following disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+// endorse or promote products derived from this software without specific prior written
+// permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef __nmea_trace_h__
+#define __nmea_trace_h__
+
+/*
+ * Trace points for the data path. When built with -DNMEA_TRACE (make
+ * TRACE=1), each trace point writes a 16 byte event with a
+ * CLOCK_MONOTONIC time to a ring in memory belonging to the calling
+ * thread. The rings are dumped to /tmp/<name>.<pid>.trace on SIGUSR2
+ * and at exit, and nmea_trace_json turns dumps into Chrome trace
+ * JSON. CLOCK_MONOTONIC is the same in all processes, so dumps from
+ * nmea_0183_read and nmea_split can be shown together. Without
+ * NMEA_TRACE, the trace points compile to nothing.
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#define TRACE_EVENTS      65536       // events kept per thread, a power of two
+#define TRACE_THREADS     16          // maximum number of threads traced
+#define TRACE_MAGIC       0x4e4d5452  // "NMTR"
+
+#define TRACE_PHASE_BEGIN  'B'
+#define TRACE_PHASE_END    'E'
+
+// Stages of the data path
+
+#define TRACE_TTY_READ     1          // read from the tty, one read() or fgets()
+#define TRACE_GPIO_CHECK   2          // check for configuration mode
+#define TRACE_OUTPUT       3          // write a sentence to stdout in nmea_0183_read
+#define TRACE_PIPE_READ    4          // wait for and read a line in nmea_split
+#define TRACE_FIFO_WRITE   5          // write a sentence to a fifo or stdout in nmea_split
+#define TRACE_RING_WRITE   6          // write a sentence to the shared memory ring
+#define TRACE_STAGE_CNT    7
+
+#define TRACE_STAGE_NAMES  { "unknown", "tty read", "gpio check", "output", \
+                             "pipe read", "fifo write", "ring write" }
+
+typedef struct {
+  uint64_t  ns;                   // CLOCK_MONOTONIC
+  uint32_t  id;                   // sentence number in this process
+  uint8_t   stage;
+  uint8_t   phase;
+  uint8_t   channel;              // 0 if not known
+  uint8_t   reserved;
+} trace_event_t;
+
+typedef struct {
+  uint32_t       tid;
+  uint32_t       n;               // events written, the last TRACE_EVENTS are kept
+  trace_event_t  ev[TRACE_EVENTS];
+} trace_ring_t;
+
+// A dump is a trace_file_hdr_t followed by each thread as a
+// trace_thread_hdr_t and its events, oldest first.
+
+typedef struct {
+  uint32_t  magic;
+  uint32_t  pid;
+  uint32_t  threads;
+  uint32_t  reserved;
+  char      name[16];             // program name
+} trace_file_hdr_t;
+
+typedef struct {
+  uint32_t  tid;
+  uint32_t  count;
+} trace_thread_hdr_t;
+
+#ifdef NMEA_TRACE
+
+extern __thread trace_ring_t*  trace_ring;
+
+// Make a ring for the calling thread.
+trace_ring_t*  trace_new_ring( void );
+
+// Set the program name for the dump file and dump on SIGUSR2 and at
+// exit.
+void  trace_init( char*  name );
+
+// Write the rings of all threads to the dump file.
+void  trace_dump( void );
+
+static inline void  trace_event( int       stage,
+                                 int       phase,
+                                 int       channel,
+                                 uint32_t  id )
+{
+  trace_ring_t*    r  =  trace_ring;
+  trace_event_t*   e;
+  struct timespec  t;
+
+  if (r == NULL) {
+    r  =  trace_new_ring();
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  e  =  &(r->ev[r->n & (TRACE_EVENTS - 1)]);
+
+  e->ns       =  t.tv_sec * 1000000000ULL + t.tv_nsec;
+  e->id       =  id;
+  e->stage    =  stage;
+  e->phase    =  phase;
+  e->channel  =  channel;
+
+  r->n++;
+}
+
+#define TRACE_INIT(name)                  trace_init(name)
+#define TRACE_BEGIN(stage, channel, id)   trace_event((stage), TRACE_PHASE_BEGIN, (channel), (id))
+#define TRACE_END(stage, channel, id)     trace_event((stage), TRACE_PHASE_END, (channel), (id))
+
+#else
+
+// The arguments are only there to avoid unused variable warnings
+#define TRACE_INIT(name)                  do {} while (0)
+#define TRACE_BEGIN(stage, channel, id)   do { (void) (channel); (void) (id); } while (0)
+#define TRACE_END(stage, channel, id)     do { (void) (channel); (void) (id); } while (0)
+
+#endif // NMEA_TRACE
+
+#endif // __nmea_trace_h__
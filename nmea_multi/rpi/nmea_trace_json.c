@@ -0,0 +1,153 @@
+// Copyright 2020 Bjarne Knudsen
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+// conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+// conditions and the following disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+// endorse or promote products derived from this software without specific prior written
+// permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nmea_trace.h"
+
+
+void  usage() {
+  fprintf(stderr, "\n");
+  fprintf(stderr, "usage: nmea_trace_json <trace file> [<trace file>] ..\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Converts trace dumps to the Chrome trace JSON format on stdout, which can be\n");
+  fprintf(stderr, "opened in Perfetto (ui.perfetto.dev) or chrome://tracing. The programs must be\n");
+  fprintf(stderr, "built with \"make TRACE=1\" and write /tmp/<program>.<pid>.trace when they get\n");
+  fprintf(stderr, "the USR2 signal and when they exit. Dumps from several programs can be given\n");
+  fprintf(stderr, "together since they use the same clock.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -h: print this help.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Example:\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  pkill -USR2 nmea_0183_read; pkill -USR2 nmea_split\n");
+  fprintf(stderr, "  nmea_trace_json /tmp/nmea_*.trace > trace.json\n");
+  fprintf(stderr, "\n");
+
+  exit(1);
+}
+
+
+// Print the events of one thread after the process name. An end
+// without a begin is skipped, which happens when the begin was
+// overwritten in the ring. Returns -1 if the file is cut short.
+static int  print_thread( FILE*                fp,
+                          trace_file_hdr_t*    hdr,
+                          trace_thread_hdr_t*  th )
+{
+  char*          names[]  =  TRACE_STAGE_NAMES;
+  int            open[TRACE_STAGE_CNT];
+  trace_event_t  e;
+  uint32_t       i;
+
+  memset(open, 0, sizeof(open));
+
+  for (i = 0; i < th->count; i++) {
+    if (fread(&e, sizeof(e), 1, fp) != 1) {
+      return  -1;
+    }
+
+    if (e.stage >= TRACE_STAGE_CNT) {
+      e.stage  =  0;
+    }
+
+    if (e.phase == TRACE_PHASE_BEGIN) {
+      open[e.stage]++;
+    }
+    else if (open[e.stage] > 0) {
+      open[e.stage]--;
+    }
+    else {
+      continue;
+    }
+
+    printf(",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%u,\"tid\":%u,"
+           "\"args\":{\"channel\":%d,\"sentence\":%u}}",
+           names[e.stage], e.phase == TRACE_PHASE_BEGIN ? 'B' : 'E',
+           (unsigned long long) (e.ns / 1000), (unsigned long long) (e.ns % 1000),
+           hdr->pid, th->tid, e.channel, e.id);
+  }
+
+  return  0;
+}
+
+
+int  main( int     argc,
+           char**  argv )
+{
+  int  first  =  1;
+  int  p;
+
+  if (argc < 2) {
+    usage();
+  }
+
+  for (p = 1; p < argc; p++) {
+    if (strcmp(argv[p], "-h") == 0) {
+      usage();
+    }
+  }
+
+  printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+  for (p = 1; p < argc; p++) {
+    FILE*               fp  =  fopen(argv[p], "r");
+    trace_file_hdr_t    hdr;
+    trace_thread_hdr_t  th;
+    uint32_t            i;
+
+    if (fp == NULL) {
+      fprintf(stderr, "Error opening trace file: %s\n", argv[p]);
+      exit(1);
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != TRACE_MAGIC) {
+      fprintf(stderr, "Not a trace file: %s\n", argv[p]);
+      exit(1);
+    }
+
+    hdr.name[sizeof(hdr.name) - 1]  =  '\0';
+
+    printf("%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"%s\"}}",
+           first ? "" : ",", hdr.pid, hdr.name);
+    first  =  0;
+
+    for (i = 0; i < hdr.threads; i++) {
+      if (fread(&th, sizeof(th), 1, fp) != 1 || print_thread(fp, &hdr, &th) < 0) {
+        fprintf(stderr, "Trace file cut short: %s\n", argv[p]);
+        exit(1);
+      }
+    }
+
+    fclose(fp);
+  }
+
+  printf("\n]}\n");
+
+  return  0;
+}
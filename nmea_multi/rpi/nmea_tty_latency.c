@@ -0,0 +1,333 @@
+// Copyright 2020 Bjarne Knudsen
+//
+// Redistribution and use in source and binary forms, with or without modification, are permitted
+// provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+// conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+// conditions and the following disclaimer in the documentation and/or other materials provided
+// with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+// endorse or promote products derived from this software without specific prior written
+// permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+// FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+// OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "nmea_0183_utils.h"
+
+#define MAX_LINE         1024
+
+#define SENTENCE         "1$GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A\r\n"
+
+typedef struct {
+  int               fd;           // master side of the pty
+  int               baud;
+  int               count;        // number of sentences to send
+  int               pause_ms;     // pause in the middle of each sentence, 0 is none
+
+  struct timespec*  sent;         // time the last byte of each sentence was written
+  struct timespec*  started;      // time the first byte of each sentence was written
+} writer_arg_t;
+
+
+void  usage() {
+  fprintf(stderr, "\n");
+  fprintf(stderr, "usage: nmea_tty_latency [options]\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Measures the time from the last byte of a sentence arriving on a tty until the\n");
+  fprintf(stderr, "sentence is returned by the reader for each read mode. A pseudo terminal is\n");
+  fprintf(stderr, "used, and the bytes are written one at a time, paced like a serial line.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -h: print this help.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -b <rate>: baud rate used for pacing. Default is 115200.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -n <count>: number of sentences per mode. Default is 200.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -d <ms>: deadline for the last row, which polls with a deadline and pauses\n");
+  fprintf(stderr, "           for twice the deadline in the middle of each sentence. The flush\n");
+  fprintf(stderr, "           row shows the time from the first byte of a sentence until the\n");
+  fprintf(stderr, "           partial sentence is returned, just over the deadline when the\n");
+  fprintf(stderr, "           deadline works. Default is 10.\n");
+  fprintf(stderr, "\n");
+
+  exit(1);
+}
+
+
+static long  diff_ns( struct timespec*  a,
+                      struct timespec*  b )
+{
+  return  (b->tv_sec - a->tv_sec) * 1000000000L + (b->tv_nsec - a->tv_nsec);
+}
+
+
+static void  add_ns( struct timespec*  t,
+                     long              ns )
+{
+  t->tv_nsec  +=  ns;
+
+  while (t->tv_nsec >= 1000000000L) {
+    t->tv_nsec  -=  1000000000L;
+    t->tv_sec++;
+  }
+}
+
+
+void*  write_sentences( void*  void_arg )
+{
+  writer_arg_t*    arg      =  (writer_arg_t*) void_arg;
+  long             byte_ns  =  10 * 1000000000L / arg->baud; // start, 8 data and stop bit
+  int              len      =  strlen(SENTENCE);
+  int              half     =  len / 2;
+  struct timespec  t;
+  int              i;
+  int              j;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+
+  for (i = 0; i < arg->count; i++) {
+    for (j = 0; j < len; j++) {
+      add_ns(&t, byte_ns);
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+
+      if (j == len - 1) {
+        clock_gettime(CLOCK_MONOTONIC, &(arg->sent[i]));
+      }
+
+      if (j == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &(arg->started[i]));
+      }
+
+      if (write(arg->fd, SENTENCE + j, 1) != 1) {
+        fprintf(stderr, "Error writing to pty.\n");
+        exit(1);
+      }
+
+      if (arg->pause_ms > 0 && j == half - 1) {
+        add_ns(&t, arg->pause_ms * 1000000L);
+      }
+    }
+  }
+
+  return  NULL;
+}
+
+
+// Print the latency from each sent time to the received time.
+static void  print_row( char*             name,
+                        struct timespec*  sent,
+                        struct timespec*  received,
+                        int               n )
+{
+  long  sum  =  0;
+  long  min  =  -1;
+  long  max  =  0;
+  int   i;
+
+  for (i = 0; i < n; i++) {
+    long  ns  =  diff_ns(&(sent[i]), &(received[i]));
+
+    sum  +=  ns;
+
+    if (min == -1 || ns < min) {
+      min  =  ns;
+    }
+
+    if (ns > max) {
+      max  =  ns;
+    }
+  }
+
+  if (n == 0) {
+    printf("%-6s  %8s  %8s  %8s  (0 sentences)\n", name, "-", "-", "-");
+    return;
+  }
+
+  printf("%-6s  %8.1f  %8.1f  %8.1f  (%d sentences)\n", name,
+         min / 1000.0, (double) sum / n / 1000.0, max / 1000.0, n);
+}
+
+
+// Send sentences through a new pty and read them with the given mode
+// and deadline. With a pause, the partial sentences flushed by the
+// deadline are measured as well.
+void  measure( int    mode,
+               char*  mode_name,
+               int    baud,
+               int    count,
+               int    deadline_ms,
+               int    pause_ms )
+{
+  struct timespec*  received  =  (struct timespec*) malloc(count * sizeof(struct timespec));
+  struct timespec*  flushed   =  (struct timespec*) malloc(count * sizeof(struct timespec));
+  writer_arg_t      arg;
+  pthread_t         thread;
+  tty_reader_t*     reader;
+  char              s[MAX_LINE];
+  int               master;
+  int               n         =  0;
+  int               f         =  0;
+
+  master  =  posix_openpt(O_RDWR | O_NOCTTY);
+
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+    fprintf(stderr, "Error opening pty.\n");
+    exit(1);
+  }
+
+  arg.fd     =  master;
+  arg.baud   =  baud;
+  arg.count     =  count;
+  arg.pause_ms  =  pause_ms;
+  arg.sent      =  (struct timespec*) malloc(count * sizeof(struct timespec));
+  arg.started   =  (struct timespec*) malloc(count * sizeof(struct timespec));
+
+  reader  =  tty_reader_open(open_tty_fd(ptsname(master), baud, 0, 1, 0), mode, deadline_ms, 0);
+
+  pthread_create(&thread, NULL, write_sentences, &arg);
+
+  while (n < count && tty_read_sentence(reader, s, MAX_LINE) > 0) {
+    if (s[strlen(s) - 1] == '\n') {
+      clock_gettime(CLOCK_MONOTONIC, &(received[n]));
+      n++;
+    }
+    else if (pause_ms > 0 && f == n && f < count) {
+      clock_gettime(CLOCK_MONOTONIC, &(flushed[f]));
+      f++;
+    }
+  }
+
+  pthread_join(thread, NULL);
+
+  print_row(mode_name, arg.sent, received, n);
+
+  if (pause_ms > 0) {
+    print_row("flush", arg.started, flushed, f);
+  }
+
+  tty_reader_close(reader);
+  close(master);
+
+  free(arg.sent);
+  free(arg.started);
+  free(received);
+  free(flushed);
+}
+
+
+int  main( int     argc,
+           char**  argv )
+{
+  int  baud      =  -1;
+  int  count     =  -1;
+  int  deadline  =  -1;
+  int  p         =  1;
+  int  i;
+
+  while (p < argc) {
+    if (strcmp(argv[p], "-h") == 0) {
+      usage();
+    }
+    else if (strcmp(argv[p], "-b") == 0) {
+      if (baud != -1) {
+        fprintf(stderr, "Baud rate given twice\n");
+        usage();
+      }
+
+      if (p + 1 >= argc) {
+        fprintf(stderr, "No baud rate given\n");
+        usage();
+      }
+
+      if (sscanf(argv[p + 1], "%d%n", &baud, &i) < 1 || argv[p + 1][i] != '\0' || baud <= 0) {
+        fprintf(stderr, "Wrong baud rate\n");
+        usage();
+      }
+
+      p  +=  2;
+    }
+    else if (strcmp(argv[p], "-n") == 0) {
+      if (count != -1) {
+        fprintf(stderr, "Count given twice\n");
+        usage();
+      }
+
+      if (p + 1 >= argc) {
+        fprintf(stderr, "No count given\n");
+        usage();
+      }
+
+      if (sscanf(argv[p + 1], "%d%n", &count, &i) < 1 || argv[p + 1][i] != '\0' || count <= 0) {
+        fprintf(stderr, "Wrong count\n");
+        usage();
+      }
+
+      p  +=  2;
+    }
+    else if (strcmp(argv[p], "-d") == 0) {
+      if (deadline != -1) {
+        fprintf(stderr, "Deadline given twice\n");
+        usage();
+      }
+
+      if (p + 1 >= argc) {
+        fprintf(stderr, "No deadline given\n");
+        usage();
+      }
+
+      if (sscanf(argv[p + 1], "%d%n", &deadline, &i) < 1 || argv[p + 1][i] != '\0' || deadline <= 0) {
+        fprintf(stderr, "Wrong deadline\n");
+        usage();
+      }
+
+      p  +=  2;
+    }
+    else {
+      fprintf(stderr, "Unknown option: %s\n", argv[p]);
+      usage();
+    }
+  }
+
+  if (baud == -1) {
+    baud  =  115200;
+  }
+
+  if (count == -1) {
+    count  =  200;
+  }
+
+  if (deadline == -1) {
+    deadline  =  10;
+  }
+
+  printf("mode    min (us)  avg (us)  max (us)\n");
+
+  measure(TTY_READ_STDIO, "stdio", baud, count, -1, 0);
+  measure(TTY_READ_BLOCK, "block", baud, count, -1, 0);
+  measure(TTY_READ_POLL, "poll", baud, count, -1, 0);
+  measure(TTY_READ_POLL, "poll+d", baud, count, deadline, 2 * deadline);
+
+  return  0;
+}